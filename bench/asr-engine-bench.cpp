@@ -0,0 +1,202 @@
+#include "bench-common.hpp"
+#include "asr-model.hpp"
+#include "resampler.hpp"
+#include "word-matcher.hpp"
+
+#include <obs-module.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <tuple>
+
+using namespace std;
+
+// Transducer against keyword spotter on the same recording, fed the way the worker pool feeds a filter:
+// 16 kHz chunks of 0.2 s, decoded until the stream has no more frames ready. Reports the decode
+// real-time factor, the per-chunk decode cost and every dirty word each engine finds, with how long
+// after the end of the word it was reported.
+//
+//   asr-engine-bench <transducer-dir> <kws-dir> <audio.wav> [words.txt] [threads]
+//
+// words.txt is a comma-separated list as in the settings (default: the built-in list).
+
+OBS_DECLARE_MODULE()
+
+static constexpr size_t kChunk = 3200;
+
+struct Hit {
+    double word_end;  // Seconds into the recording
+    double reported;  // Audio fed when the engine reported it
+    string word;
+};
+
+struct EngineRun {
+    string label;
+    double load_ms = 0.0;
+    double warmup_ms = 0.0;
+    double decode_s = 0.0;
+    double max_chunk_ms = 0.0;
+    size_t chunks = 0;
+    vector<Hit> hits;
+};
+
+static vector<string> LoadWords(const string &path) {
+    ifstream f(path, ios::binary);
+    stringstream ss;
+    ss << f.rdbuf();
+    string combined = ss.str();
+    vector<string> words;
+    stringstream items(combined);
+    string item;
+    while (getline(items, item, ',')) {
+        item.erase(0, item.find_first_not_of(" \t\n\r"));
+        item.erase(item.find_last_not_of(" \t\n\r") + 1);
+        if (!item.empty()) words.push_back(item);
+    }
+    return words;
+}
+
+// Mono 16 kHz, through the plugin's resampler if the file has another rate
+static vector<float> LoadAudio(const string &path) {
+    vector<float> out;
+    const SherpaOnnxWave *wave = SherpaOnnxReadWave(path.c_str());
+    if (!wave) return out;
+    if (wave->sample_rate == 16000) {
+        out.assign(wave->samples, wave->samples + wave->num_samples);
+    } else {
+        PolyphaseResampler resampler;
+        resampler.Configure((uint32_t)wave->sample_rate, 16000);
+        out.resize(resampler.MaxOutput((size_t)wave->num_samples));
+        out.resize(resampler.Process(wave->samples, (size_t)wave->num_samples, out.data()));
+    }
+    SherpaOnnxFreeWave(wave);
+    return out;
+}
+
+// Keyword hits: one per result, the stream restarts after each (as AsrHandleKeywordResult does)
+static bool CollectKeyword(const ASRModel &model, const SherpaOnnxOnlineStream *stream, double segment_start,
+                           double fed, EngineRun &run) {
+    const SherpaOnnxKeywordResult *result = SherpaOnnxGetKeywordResult(model.keyword_spotter, stream);
+    if (!result) return false;
+    bool detected = result->keyword && result->keyword[0] && result->count > 0;
+    if (detected) run.hits.push_back({segment_start + result->timestamps[result->count - 1], fed, result->keyword});
+    SherpaOnnxDestroyKeywordResult(result);
+    return detected;
+}
+
+// Transcript hits: the tokens are joined and matched like MatchTokens does, each match reported once per segment
+static void CollectTranscript(const ASRModel &model, const SherpaOnnxOnlineStream *stream, const WordMatcher &matcher,
+                              double segment_start, double fed, set<tuple<size_t, size_t>> &reported, EngineRun &run) {
+    const SherpaOnnxOnlineRecognizerResult *result = SherpaOnnxGetOnlineStreamResult(model.recognizer, stream);
+    if (!result) return;
+    string text;
+    vector<size_t> token_end;
+    for (int32_t t = 0; t < result->count; t++) {
+        text += result->tokens_arr[t];
+        token_end.push_back(text.size());
+    }
+    vector<WordMatcher::Match> matches;
+    matcher.FindAll(text, matches);
+    for (const auto &m : matches) {
+        if (!reported.insert({m.start, m.length}).second) continue;
+        size_t last = (size_t)(lower_bound(token_end.begin(), token_end.end(), m.start + m.length) - token_end.begin());
+        last = min(last, token_end.size() - 1);
+        run.hits.push_back({segment_start + result->timestamps[last], fed, text.substr(m.start, m.length)});
+    }
+    SherpaOnnxDestroyOnlineRecognizerResult(result);
+}
+
+static bool RunEngine(const string &dir, EngineMode mode, const vector<string> &words, int threads,
+                      const vector<float> &audio, EngineRun &run) {
+    EngineOptions options;
+    options.num_threads = threads;
+    string error;
+    auto load_start = chrono::steady_clock::now();
+    ASRModel model(dir, mode, words, options, error);
+    run.load_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - load_start).count();
+    if (!model.IsValid()) {
+        fprintf(stderr, "%s: %s\n", dir.c_str(), error.c_str());
+        return false;
+    }
+    char label[160];
+    snprintf(label, sizeof(label), "%s [%s, %d threads%s%s]", mode == EngineMode::KeywordSpotter ? "KWS" : "transducer",
+        model.variant.c_str(), threads, model.recognizer ? ", " : "", model.recognizer ? options.decoding_method.c_str() : "");
+    run.label = label;
+    run.warmup_ms = model.WarmUp();
+
+    WordMatcher matcher;
+    matcher.Build(words);
+    set<tuple<size_t, size_t>> reported;
+
+    const SherpaOnnxOnlineStream *stream = model.CreateStream();
+    double segment_start = 0.0;
+    for (size_t pos = 0; pos + kChunk <= audio.size(); pos += kChunk) {
+        SherpaOnnxOnlineStreamAcceptWaveform(stream, 16000, audio.data() + pos, (int32_t)kChunk);
+        auto decode_start = chrono::steady_clock::now();
+        while (model.IsReady(stream)) model.Decode(&stream, 1);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - decode_start).count();
+        run.decode_s += ms / 1000.0;
+        run.max_chunk_ms = max(run.max_chunk_ms, ms);
+        run.chunks++;
+
+        double fed = (double)(pos + kChunk) / 16000.0;
+        bool reset;
+        if (model.keyword_spotter) {
+            reset = CollectKeyword(model, stream, segment_start, fed, run);
+        } else {
+            CollectTranscript(model, stream, matcher, segment_start, fed, reported, run);
+            reset = SherpaOnnxOnlineStreamIsEndpoint(model.recognizer, stream) != 0;
+        }
+        if (reset) {
+            model.ResetStream(stream);
+            segment_start = fed;
+            reported.clear();
+        }
+    }
+    SherpaOnnxDestroyOnlineStream(stream);
+    return true;
+}
+
+static void Report(const EngineRun &run, double audio_s) {
+    printf("%s\n", run.label.c_str());
+    printf("  load %.0f ms, warm-up %.0f ms\n", run.load_ms, run.warmup_ms);
+    printf("  decode RTF %.3f, %.1f ms per 0.2 s chunk on average, %.1f ms at most\n", run.decode_s / audio_s,
+        run.decode_s * 1000.0 / (double)max<size_t>(run.chunks, 1), run.max_chunk_ms);
+    double lag = 0.0;
+    for (const auto &h : run.hits) {
+        printf("  %8.2f s  +%.2f s  %s\n", h.word_end, h.reported - h.word_end, h.word.c_str());
+        lag += h.reported - h.word_end;
+    }
+    printf("  %zu hits, reported %.2f s after the word on average\n", run.hits.size(),
+        run.hits.empty() ? 0.0 : lag / (double)run.hits.size());
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s <transducer-dir> <kws-dir> <audio.wav> [words.txt] [threads]\n", argv[0]);
+        return 2;
+    }
+    string words_path = argc > 4 ? argv[4] : string(BENCH_DATA_DIR) + "/builtin_dirty_words.txt";
+    int threads = argc > 5 ? atoi(argv[5]) : 1;
+
+    vector<string> words = LoadWords(words_path);
+    vector<float> audio = LoadAudio(argv[3]);
+    if (words.empty() || audio.empty()) {
+        fprintf(stderr, "no words in %s or no audio in %s\n", words_path.c_str(), argv[3]);
+        return 2;
+    }
+    double audio_s = (double)(audio.size() / kChunk * kChunk) / 16000.0;
+    printf("%.1f s of audio, %zu words\n\n", audio_s, words.size());
+
+    EngineRun transducer, kws;
+    if (!RunEngine(argv[1], EngineMode::Transducer, words, threads, audio, transducer)) return 1;
+    if (!RunEngine(argv[2], EngineMode::KeywordSpotter, words, threads, audio, kws)) return 1;
+    Report(transducer, audio_s);
+    printf("\n");
+    Report(kws, audio_s);
+    printf("\nKWS decode cost: %.2fx the transducer's\n", kws.decode_s / transducer.decode_s);
+    return 0;
+}
@@ -0,0 +1,420 @@
+#include "bench-common.hpp"
+#include "delay-line.hpp"
+#include "resampler.hpp"
+#include "spsc-ring.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// The pieces of the audio callback: DelayLine (wrap points, out-of-range reads, the sliced handover),
+// SpscRing (wrap, overflow, one producer and one consumer thread) and PolyphaseResampler (passband,
+// stopband, block-size independence). The timings compare the delay line against the per-sample modulo
+// ring it replaced, at 48 kHz with 2 and 8 channels, and give the resampler's share of real time.
+
+static constexpr double kPi = 3.14159265358979323846;
+
+// --- DelayLine ---
+
+// The removed ring: arbitrary size, one modulo per written sample and two per read sample
+struct ModuloRing {
+    vector<vector<float>> buffers;
+    size_t head = 0;
+    uint64_t written = 0;
+
+    ModuloRing(size_t channels, size_t size) : buffers(channels, vector<float>(size, 0.0f)) {}
+
+    void Write(const float *const *planes, size_t frames) {
+        size_t size = buffers[0].size();
+        size_t start = head;
+        for (size_t c = 0; c < buffers.size(); c++) {
+            head = start;
+            for (size_t i = 0; i < frames; i++) {
+                buffers[c][head] = planes[c][i];
+                head = (head + 1) % size;
+            }
+        }
+        written += frames;
+    }
+
+    void ReadDelayed(size_t frames, size_t delay, float *const *out) const {
+        size_t size = buffers[0].size();
+        for (size_t c = 0; c < buffers.size(); c++) {
+            for (size_t i = 0; i < frames; i++) {
+                int64_t target = (int64_t)(written - frames + i) - (int64_t)delay;
+                if (target < 0) {
+                    out[c][i] = 0.0f;
+                } else {
+                    size_t diff = (size_t)(written - (uint64_t)target);
+                    size_t idx = (head + size - (diff % size)) % size;
+                    out[c][i] = buffers[c][idx];
+                }
+            }
+        }
+    }
+};
+
+// Sample value at absolute position p of channel c, so any slot can be checked without keeping the input
+static float Tagged(size_t c, uint64_t p) {
+    return (float)(p % 100000) + 0.25f * (float)c;
+}
+
+static void FillTagged(vector<vector<float>> &planes, uint64_t start, size_t frames) {
+    for (size_t c = 0; c < planes.size(); c++) {
+        for (size_t i = 0; i < frames; i++) planes[c][i] = Tagged(c, start + i);
+    }
+}
+
+static vector<const float *> Pointers(const vector<vector<float>> &planes) {
+    vector<const float *> out;
+    for (const auto &p : planes) out.push_back(p.data());
+    return out;
+}
+
+static void CheckDelayLine() {
+    CHECK(DelayLine::RoundUp(0) == 1);
+    CHECK(DelayLine::RoundUp(1000) == 1024);
+    CHECK(DelayLine::RoundUp(1024) == 1024);
+
+    DelayLine line;
+    line.Allocate(2, 1000);
+    CHECK(line.Capacity() == 1024);
+    CHECK(line.Channels() == 2);
+    CHECK(line.Bytes() == 2 * 1024 * sizeof(float));
+
+    // Block sizes that put the write split at every offset sooner or later
+    Lcg rng;
+    vector<vector<float>> planes(2, vector<float>(2048));
+    vector<const float *> ptrs = Pointers(planes);
+    bool all_held = true;
+    for (int block = 0; block < 400; block++) {
+        size_t frames = 1 + rng.Below(700);
+        FillTagged(planes, line.End(), frames);
+        line.Write(ptrs.data(), 2, frames);
+        for (uint64_t p = line.Oldest(); p < line.End(); p += 1 + rng.Below(16)) {
+            all_held = all_held && line.At(0, (int64_t)p) == Tagged(0, p) && line.At(1, (int64_t)p) == Tagged(1, p);
+        }
+    }
+    CHECK(all_held);
+    CHECK(line.End() - line.Oldest() == line.Capacity());
+
+    // Reads straddling the oldest sample, the ring's wrap point and the newest sample
+    vector<float> out(3000);
+    bool reads_ok = true;
+    for (int round = 0; round < 200; round++) {
+        int64_t start = (int64_t)line.Oldest() - 500 + (int64_t)rng.Below((uint32_t)line.Capacity() + 1000);
+        size_t n = 1 + rng.Below(2000);
+        line.Read(1, start, n, out.data());
+        for (size_t i = 0; i < n; i++) {
+            int64_t p = start + (int64_t)i;
+            bool held = p >= (int64_t)line.Oldest() && p < (int64_t)line.End();
+            reads_ok = reads_ok && out[i] == (held ? Tagged(1, (uint64_t)p) : 0.0f);
+        }
+    }
+    CHECK(reads_ok);
+    CHECK(line.At(0, -1) == 0.0f);
+    CHECK(line.At(0, (int64_t)line.End()) == 0.0f);
+
+    // Null planes and missing planes are written as silence
+    const float *one[1] = {planes[0].data()};
+    FillTagged(planes, line.End(), 10);
+    line.Write(one, 1, 10);
+    CHECK(line.At(0, (int64_t)line.End() - 1) == Tagged(0, line.End() - 1));
+    CHECK(line.At(1, (int64_t)line.End() - 1) == 0.0f);
+    const float *none[2] = {nullptr, nullptr};
+    line.Write(none, 2, 5);
+    CHECK(line.At(0, (int64_t)line.End() - 1) == 0.0f);
+
+    // A block longer than the ring keeps its newest samples
+    DelayLine small;
+    small.Allocate(1, 64);
+    vector<vector<float>> big(1, vector<float>(1000));
+    FillTagged(big, 0, 1000);
+    vector<const float *> big_ptrs = Pointers(big);
+    small.Write(big_ptrs.data(), 1, 1000);
+    CHECK(small.End() == 1000);
+    CHECK(small.Oldest() == 1000 - 64);
+    CHECK(small.At(0, 999) == Tagged(0, 999));
+    CHECK(small.At(0, 1000 - 64) == Tagged(0, 1000 - 64));
+
+    // Swap exchanges everything
+    DelayLine other;
+    other.Swap(small);
+    CHECK(small.Capacity() == 0 && other.Capacity() == 64 && other.End() == 1000);
+    other.Release();
+    CHECK(other.Capacity() == 0 && other.End() == 0);
+}
+
+// Handover into a line of another size while the audio keeps coming, as ProcessAudio does it: every
+// callback writes to both lines and copies one slice of history
+static void CheckHandover(size_t from_capacity, size_t to_capacity, size_t to_channels, size_t slice) {
+    DelayLine from, to;
+    from.Allocate(2, from_capacity);
+    vector<vector<float>> planes(2, vector<float>(300));
+    vector<const float *> ptrs = Pointers(planes);
+    for (int k = 0; k < 20; k++) {
+        FillTagged(planes, from.End(), 300);
+        from.Write(ptrs.data(), 2, 300);
+    }
+
+    to.Allocate(to_channels, to_capacity);
+    to.BeginHandover(from);
+    CHECK(to.End() == from.End());
+    int callbacks = 0;
+    while (!to.ContinueHandover(from, slice) && callbacks < 10000) {
+        FillTagged(planes, from.End(), 300);
+        from.Write(ptrs.data(), 2, 300);
+        to.Write(ptrs.data(), 2, 300);
+        callbacks++;
+    }
+    CHECK(callbacks < 10000);
+
+    // Everything both lines hold is in place, channels the old line did not have are silent
+    bool ok = true;
+    uint64_t floor = max(from.Oldest(), to.Oldest());
+    for (uint64_t p = floor; p < to.End(); p++) {
+        for (size_t c = 0; c < to_channels; c++) {
+            ok = ok && to.At(c, (int64_t)p) == (c < 2 ? Tagged(c, p) : 0.0f);
+        }
+    }
+    CHECK(ok);
+    // Finished handovers report done without copying again
+    CHECK(to.ContinueHandover(from, slice));
+}
+
+// The new write + read path produces exactly what the modulo ring did
+static void CheckAgainstModuloRing() {
+    const size_t channels = 2, delay = 5000;
+    ModuloRing ring(channels, 12345);
+    DelayLine line;
+    line.Allocate(channels, delay + 4096);
+    Lcg rng;
+    vector<vector<float>> in(channels, vector<float>(4096)), old_out = in, new_out = in;
+    vector<float *> old_ptrs = {old_out[0].data(), old_out[1].data()};
+    bool same = true;
+    for (int block = 0; block < 300; block++) {
+        size_t frames = 1 + rng.Below(4096);
+        for (auto &p : in) {
+            for (size_t i = 0; i < frames; i++) p[i] = rng.Signal();
+        }
+        vector<const float *> ptrs = Pointers(in);
+        ring.Write(ptrs.data(), frames);
+        ring.ReadDelayed(frames, delay, old_ptrs.data());
+        line.Write(ptrs.data(), channels, frames);
+        for (size_t c = 0; c < channels; c++) {
+            line.Read(c, (int64_t)line.End() - (int64_t)frames - (int64_t)delay, frames, new_out[c].data());
+            same = same && equal(old_out[c].begin(), old_out[c].begin() + (ptrdiff_t)frames, new_out[c].begin());
+        }
+    }
+    CHECK(same);
+}
+
+// --- SpscRing ---
+
+static void CheckSpscRing() {
+    SpscRing<float> ring(100);
+    CHECK(ring.Capacity() == 128);
+
+    // Odd block sizes walk the wrap point through every offset
+    vector<float> block(128), out(128);
+    float next_in = 0.0f, next_out = 0.0f;
+    bool ok = true;
+    for (int round = 0; round < 500; round++) {
+        size_t n = 1 + (size_t)round % 97;
+        for (size_t i = 0; i < n; i++) block[i] = next_in++;
+        ok = ok && ring.Write(block.data(), n);
+        size_t got = ring.Read(out.data(), 128);
+        ok = ok && got == n;
+        for (size_t i = 0; i < got; i++) ok = ok && out[i] == next_out++;
+    }
+    CHECK(ok);
+    CHECK(ring.Size() == 0);
+    CHECK(ring.OverflowEvents() == 0);
+
+    // A block that does not fit is dropped whole and counted
+    CHECK(ring.Write(block.data(), 100));
+    CHECK(!ring.Write(block.data(), 29));
+    CHECK(ring.Size() == 100);
+    CHECK(ring.OverflowEvents() == 1);
+    CHECK(ring.OverflowSamples() == 29);
+    CHECK(ring.Write(block.data(), 28));
+    CHECK(ring.Size() == 128);
+
+    ring.Drop(7);
+    CHECK(ring.OverflowEvents() == 2);
+    CHECK(ring.OverflowSamples() == 36);
+
+    CHECK(ring.Read(out.data(), 10) == 10);
+    ring.Clear();
+    CHECK(ring.Size() == 0);
+    CHECK(ring.Read(out.data(), 10) == 0);
+    CHECK(ring.Write(block.data(), 0));
+}
+
+// One producer and one consumer thread: every sample arrives once and in order
+static void CheckSpscThreads() {
+    SpscRing<uint32_t> ring(1024);
+    const uint32_t total = 2000000;
+    thread producer([&] {
+        vector<uint32_t> block(61);
+        uint32_t next = 0;
+        while (next < total) {
+            size_t n = min<size_t>(block.size(), total - next);
+            for (size_t i = 0; i < n; i++) block[i] = next + (uint32_t)i;
+            if (ring.Write(block.data(), n)) next += (uint32_t)n;
+            else this_thread::yield();
+        }
+    });
+    vector<uint32_t> out(200);
+    uint32_t expected = 0;
+    bool ordered = true;
+    while (expected < total) {
+        size_t got = ring.Read(out.data(), out.size());
+        for (size_t i = 0; i < got; i++) ordered = ordered && out[i] == expected++;
+        if (!got) this_thread::yield();
+    }
+    producer.join();
+    CHECK(ordered);
+    CHECK(ring.Size() == 0);
+}
+
+// --- PolyphaseResampler ---
+
+// Output level in dB relative to the input for a full-scale sine at freq, after the filter has settled
+static double SineLevel(uint32_t rate, double freq, double seconds) {
+    PolyphaseResampler r;
+    r.Configure(rate, 16000);
+    size_t n = (size_t)(rate * seconds);
+    vector<float> in(n), out(r.MaxOutput(n));
+    for (size_t i = 0; i < n; i++) in[i] = (float)sin(2.0 * kPi * freq * (double)i / rate);
+    size_t m = 0;
+    for (size_t k = 0; k < n; k += 1024) m += r.Process(&in[k], min<size_t>(1024, n - k), &out[m]);
+    double energy = 0.0;
+    for (size_t i = m / 4; i < m; i++) energy += (double)out[i] * out[i];
+    return 10.0 * log10(max(energy / (double)(m - m / 4) / 0.5, 1e-20));
+}
+
+// Worst level over [from, to) and the frequency it occurs at
+static double WorstLevel(uint32_t rate, double from, double to, double step, double seconds, double &at) {
+    double worst = -400.0;
+    for (double f = from; f < to; f += step) {
+        double level = SineLevel(rate, f, seconds);
+        if (level > worst) {
+            worst = level;
+            at = f;
+        }
+    }
+    return worst;
+}
+
+static void CheckResampler() {
+    PolyphaseResampler r;
+    CHECK(!r.IsConfigured());
+    r.Configure(48000, 16000);
+    CHECK(r.Up() == 1 && r.Down() == 3 && r.InputRate() == 48000);
+    r.Configure(44100, 16000);
+    CHECK(r.Up() == 160 && r.Down() == 441);
+
+    for (uint32_t rate : {48000u, 44100u}) {
+        // Flat passband, and nothing above the output Nyquist folds back into it
+        CHECK(fabs(SineLevel(rate, 1000.0, 0.25)) < 0.1);
+        CHECK(fabs(SineLevel(rate, 5000.0, 0.25)) < 0.1);
+        double at = 0.0;
+        double worst = WorstLevel(rate, 8000.0, rate / 2.0, 100.0, 0.25, at);
+        CHECK(worst < -PolyphaseResampler::kStopbandDb + 5.0);
+
+        // Output does not depend on how the input is split into blocks
+        Lcg rng;
+        PolyphaseResampler a, b;
+        a.Configure(rate, 16000);
+        b.Configure(rate, 16000);
+        vector<float> in(rate), whole(a.MaxOutput(rate) + 16), pieces(whole.size());
+        for (auto &s : in) s = rng.Signal();
+        size_t n_whole = a.Process(in.data(), in.size(), whole.data());
+        size_t n_pieces = 0;
+        for (size_t k = 0; k < in.size();) {
+            size_t n = min<size_t>(1 + rng.Below(2000), in.size() - k);
+            n_pieces += b.Process(&in[k], n, &pieces[n_pieces]);
+            k += n;
+        }
+        CHECK(n_whole == n_pieces);
+        CHECK(llabs((long long)n_whole - (long long)(in.size() * 16000 / rate)) <= 1);
+        float diff = 0.0f;
+        for (size_t i = 0; i < min(n_whole, n_pieces); i++) diff = max(diff, fabs(whole[i] - pieces[i]));
+        CHECK(diff < 1e-5f);
+
+        // Reset restarts from silence, Swap hands the configured bank over
+        a.Reset();
+        vector<float> again(whole.size());
+        CHECK(a.Process(in.data(), in.size(), again.data()) == n_whole);
+        CHECK(equal(again.begin(), again.begin() + (ptrdiff_t)n_whole, whole.begin()));
+        PolyphaseResampler empty;
+        empty.Swap(a);
+        CHECK(empty.IsConfigured() && empty.InputRate() == rate && !a.IsConfigured());
+    }
+}
+
+// --- Timings ---
+
+static void RunTimings() {
+    const uint32_t rate = 48000;
+    const size_t frames = 1024;
+    const size_t delay = rate / 2;
+    printf("Delay line, %u Hz, %zu-frame blocks, %.1f s delay (write + delayed read per callback):\n", rate, frames,
+        (double)delay / rate);
+    for (size_t channels : {2, 8}) {
+        vector<vector<float>> in(channels, vector<float>(frames, 0.5f)), out = in;
+        vector<const float *> in_ptrs = Pointers(in);
+        vector<float *> out_ptrs;
+        for (auto &p : out) out_ptrs.push_back(p.data());
+
+        // The old ring was sized to 12 s of audio
+        ModuloRing ring(channels, rate * 12);
+        double old_us = TimeUs([&] {
+            ring.Write(in_ptrs.data(), frames);
+            ring.ReadDelayed(frames, delay, out_ptrs.data());
+        }, 0.5);
+
+        DelayLine line;
+        line.Allocate(channels, delay + rate);
+        double new_us = TimeUs([&] {
+            line.Write(in_ptrs.data(), channels, frames);
+            int64_t start = (int64_t)line.End() - (int64_t)frames - (int64_t)delay;
+            for (size_t c = 0; c < channels; c++) line.Read(c, start, frames, out_ptrs[c]);
+        }, 0.5);
+        printf("  %zu ch: modulo ring %6.2f us, delay line %6.2f us per block (%.0fx)\n", channels, old_us, new_us,
+            old_us / new_us);
+    }
+
+    printf("Resampler to 16 kHz, %zu-frame blocks:\n", frames);
+    for (uint32_t in_rate : {48000u, 44100u}) {
+        PolyphaseResampler r;
+        r.Configure(in_rate, 16000);
+        vector<float> in(frames), out(r.MaxOutput(frames));
+        Lcg rng;
+        for (auto &s : in) s = rng.Signal();
+        double us = TimeUs([&] { r.Process(in.data(), frames, out.data()); }, 0.5);
+        double at = 0.0;
+        double worst = WorstLevel(in_rate, 8000.0, in_rate / 2.0, 25.0, 1.0, at);
+        printf("  %u Hz: %.2f us per block, %.3f%% of real time; stopband worst %.1f dB at %.0f Hz\n", in_rate, us,
+            100.0 * us * 1e-6 / ((double)frames / in_rate), worst, at);
+    }
+}
+
+int main(int argc, char **argv) {
+    CheckDelayLine();
+    CheckHandover(1024, 4096, 3, 100);  // Growing, with a channel the old line lacks
+    CheckHandover(8192, 2048, 2, 333);  // Shrinking: only what fits is copied
+    CheckHandover(1024, 1024, 2, 5000); // One slice
+    CheckAgainstModuloRing();
+    CheckSpscRing();
+    CheckSpscThreads();
+    CheckResampler();
+    int result = CheckResult("audio-path");
+    if (result == 0 && TimingsWanted(argc, argv)) RunTimings();
+    return result;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Shared by the standalone benchmarks: behaviour checks that count failures instead of aborting,
+// a wall-clock timer and a deterministic random source, so runs are comparable between builds.
+
+inline int g_check_failures = 0;
+
+#define CHECK(cond)                                                                     \
+    do {                                                                                \
+        if (!(cond)) {                                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);   \
+            g_check_failures++;                                                         \
+        }                                                                               \
+    } while (0)
+
+// "--check" runs the behaviour checks only (what ctest does), otherwise the timings follow
+inline bool TimingsWanted(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--check") == 0) return false;
+    }
+    return true;
+}
+
+// Exit code for main: non-zero if any check failed
+inline int CheckResult(const char *name) {
+    if (g_check_failures) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, g_check_failures);
+        return 1;
+    }
+    printf("%s: all checks passed\n", name);
+    return 0;
+}
+
+// Mean wall time of fn in microseconds, repeated until min_seconds have passed (at least once)
+template <typename F>
+double TimeUs(F &&fn, double min_seconds = 0.2) {
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    uint64_t runs = 0;
+    double elapsed = 0.0;
+    do {
+        fn();
+        runs++;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    } while (elapsed < min_seconds);
+    return elapsed * 1e6 / (double)runs;
+}
+
+// Same LCG as ASRModel::WarmUp
+struct Lcg {
+    uint32_t state = 12345;
+
+    uint32_t Next() {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    }
+    // Uniform in [0, n)
+    uint32_t Below(uint32_t n) { return Next() % n; }
+    // Uniform in [-1, 1)
+    float Signal() { return (float)Next() / (float)(1u << 23) - 1.0f; }
+};
+
+// Appends the UTF-8 encoding of a BMP code point
+inline void AppendUtf8(std::string &out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
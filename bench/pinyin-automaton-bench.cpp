@@ -0,0 +1,200 @@
+#include "bench-common.hpp"
+#include "aho-corasick.hpp"
+
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// The syllable-ID automaton PinyinMatcher scans with against the loop it replaced: every pattern
+// (a vector of pinyin strings) string-compared at every position of the transcript's pinyin.
+// PinyinMatcher::Build needs the pinyin dictionary, so the patterns here are synthetic syllables
+// interned the same way (one small integer per distinct syllable).
+
+typedef vector<int32_t> Syllables;
+typedef set<tuple<size_t, size_t, Syllables>> MatchSet; // (start, length, matched pattern)
+
+static AhoCorasick<int32_t> Compile(const vector<Syllables> &patterns) {
+    AhoCorasick<int32_t> automaton;
+    for (const auto &p : patterns) automaton.Add(p.data(), p.size());
+    automaton.Compile();
+    return automaton;
+}
+
+static MatchSet Scan(const AhoCorasick<int32_t> &automaton, const vector<Syllables> &patterns, const Syllables &text) {
+    MatchSet out;
+    automaton.Scan(text.data(), text.size(), [&](int32_t id, size_t start, size_t len) {
+        out.insert({start, len, patterns[id]});
+    });
+    return out;
+}
+
+// The removed matching loop, on IDs so the results compare directly
+static MatchSet Naive(const vector<Syllables> &patterns, const Syllables &text) {
+    MatchSet out;
+    for (const auto &pat : patterns) {
+        if (pat.empty() || pat.size() > text.size()) continue;
+        for (size_t i = 0; i <= text.size() - pat.size(); i++) {
+            bool match = true;
+            for (size_t j = 0; j < pat.size(); j++) {
+                if (text[i + j] != pat[j]) {
+                    match = false;
+                    break;
+                }
+            }
+            if (match) out.insert({i, pat.size(), pat});
+        }
+    }
+    return out;
+}
+
+static void CheckAutomaton() {
+    // Ids follow insertion order, empty patterns are ignored, duplicates report the first id
+    AhoCorasick<int32_t> a;
+    const int32_t p0[] = {1, 2};
+    const int32_t p1[] = {2, 3};
+    CHECK(a.Add(p0, 2) == 0);
+    CHECK(a.Add(p0, 0) == -1);
+    CHECK(a.Add(p1, 2) == 1);
+    CHECK(a.Add(p0, 2) == 2);
+    a.Compile();
+    CHECK(a.PatternCount() == 3);
+    CHECK(a.MaxPatternLength() == 2);
+    vector<int32_t> ids;
+    const int32_t t0[] = {1, 2};
+    a.Scan(t0, 2, [&](int32_t id, size_t, size_t) { ids.push_back(id); });
+    CHECK(ids == vector<int32_t>({0}));
+
+    // Suffixes of a match report through the dictionary links
+    vector<Syllables> nested = {{1, 2, 3}, {2, 3}, {3}};
+    CHECK(Scan(Compile(nested), nested, {1, 2, 3}) ==
+          MatchSet({{0, 3, {1, 2, 3}}, {1, 2, {2, 3}}, {2, 1, {3}}}));
+
+    // A failed partial match falls back to the longest suffix that is still a prefix
+    vector<Syllables> fallback = {{1, 2, 4}, {2, 3}};
+    CHECK(Scan(Compile(fallback), fallback, {1, 2, 3}) == MatchSet({{1, 2, {2, 3}}}));
+    CHECK(Scan(Compile(fallback), fallback, {1, 1, 2, 4}) == MatchSet({{1, 3, {1, 2, 4}}}));
+
+    // Repeats overlap, and matches at both ends of the text report
+    vector<Syllables> repeat = {{5, 5}};
+    CHECK(Scan(Compile(repeat), repeat, {5, 5, 5}) == MatchSet({{0, 2, {5, 5}}, {1, 2, {5, 5}}}));
+
+    // Depth tracks the matched prefix, a mismatch from the root stays at the root
+    AhoCorasick<int32_t> b = Compile(fallback);
+    int32_t state = b.Step(0, 1);
+    state = b.Step(state, 2);
+    CHECK(b.Depth(state) == 2);
+    state = b.Step(state, 9);
+    CHECK(b.Depth(state) == 0);
+
+    // Nothing compiled or nothing added: scans find nothing
+    AhoCorasick<int32_t> empty;
+    CHECK(Scan(empty, {}, {1, 2}).empty());
+    empty.Compile();
+    CHECK(empty.Empty());
+    CHECK(Scan(empty, {}, {1, 2}).empty());
+}
+
+// Random patterns and texts over a small syllable set (many shared prefixes and suffixes)
+static void CheckAgainstNaive() {
+    Lcg rng;
+    for (int round = 0; round < 50; round++) {
+        vector<Syllables> patterns(1 + rng.Below(40));
+        for (auto &p : patterns) {
+            p.resize(1 + rng.Below(4));
+            for (auto &s : p) s = (int32_t)rng.Below(6);
+        }
+        Syllables text(rng.Below(300));
+        for (auto &s : text) s = (int32_t)rng.Below(6);
+        CHECK(Scan(Compile(patterns), patterns, text) == Naive(patterns, text));
+    }
+}
+
+// A pinyin-like syllable inventory, so the string compare in the old loop works on realistic lengths
+static vector<string> SyllableInventory() {
+    static const char *kInitials[] = {"", "b", "p", "m", "f", "d", "t", "n", "l", "g", "k", "h", "j", "q", "x",
+                                      "zh", "ch", "sh", "r", "z", "c", "s", "y", "w"};
+    static const char *kFinals[] = {"a", "o", "e", "i", "u", "ai", "ei", "ao", "ou", "an", "en", "ang", "eng",
+                                    "ong", "ia", "ie", "iao", "iu", "ian", "in", "iang", "ing", "ua", "uo"};
+    vector<string> out;
+    for (const char *ini : kInitials) {
+        for (const char *fin : kFinals) out.push_back(string(ini) + fin);
+    }
+    return out;
+}
+
+static void RunTimings() {
+    Lcg rng;
+    vector<string> inventory = SyllableInventory();
+    const size_t kPatterns = 500;
+    const size_t kWindow = 200;
+
+    vector<vector<string>> string_patterns(kPatterns);
+    for (auto &p : string_patterns) {
+        p.resize(2 + rng.Below(3));
+        for (auto &s : p) s = inventory[rng.Below((uint32_t)inventory.size())];
+    }
+    vector<string> string_text;
+    while (string_text.size() < kWindow) {
+        if (rng.Below(20) == 0) {
+            const auto &p = string_patterns[rng.Below(kPatterns)];
+            string_text.insert(string_text.end(), p.begin(), p.end());
+        } else {
+            string_text.push_back(inventory[rng.Below((uint32_t)inventory.size())]);
+        }
+    }
+
+    // Interned once, as PinyinEngine does for the dictionary and the token table
+    unordered_map<string, int32_t> ids;
+    auto intern = [&](const string &s) { return ids.emplace(s, (int32_t)ids.size()).first->second; };
+    vector<Syllables> patterns;
+    for (const auto &p : string_patterns) {
+        Syllables ip;
+        for (const auto &s : p) ip.push_back(intern(s));
+        patterns.push_back(ip);
+    }
+    Syllables text;
+    for (const auto &s : string_text) text.push_back(intern(s));
+
+    size_t naive_matches = 0;
+    double naive_us = TimeUs([&] {
+        naive_matches = 0;
+        for (const auto &pat : string_patterns) {
+            if (pat.size() > string_text.size()) continue;
+            for (size_t i = 0; i <= string_text.size() - pat.size(); i++) {
+                bool match = true;
+                for (size_t j = 0; j < pat.size(); j++) {
+                    if (string_text[i + j] != pat[j]) {
+                        match = false;
+                        break;
+                    }
+                }
+                if (match) naive_matches++;
+            }
+        }
+    });
+    AhoCorasick<int32_t> automaton;
+    double build_us = TimeUs([&] { automaton = Compile(patterns); });
+    size_t automaton_matches = 0;
+    double automaton_us = TimeUs([&] {
+        automaton_matches = 0;
+        automaton.Scan(text.data(), text.size(), [&](int32_t, size_t, size_t) { automaton_matches++; });
+    });
+
+    printf("%zu patterns of 2-4 syllables, %zu-syllable window\n", kPatterns, text.size());
+    printf("  scan per chunk: string compare %8.1f us   automaton %8.2f us   (%.0fx)\n", naive_us, automaton_us,
+        naive_us / automaton_us);
+    printf("  build:          automaton %.1f us\n", build_us);
+    printf("  matches:        string compare %8zu      automaton %8zu\n", naive_matches, automaton_matches);
+}
+
+int main(int argc, char **argv) {
+    CheckAutomaton();
+    CheckAgainstNaive();
+    int result = CheckResult("pinyin-automaton");
+    if (result == 0 && TimingsWanted(argc, argv)) RunTimings();
+    return result;
+}
@@ -0,0 +1,207 @@
+#include "bench-common.hpp"
+#include "word-matcher.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <utility>
+
+using namespace std;
+
+// WordMatcher (one UTF-8 Aho-Corasick automaton plus the std::regex fallback) against the matcher it
+// replaced: one std::regex with icase per word, each scanned over the whole transcript.
+
+typedef set<pair<size_t, size_t>> MatchSet; // (start, length) in bytes
+
+static MatchSet Find(const WordMatcher &matcher, const string &text) {
+    vector<WordMatcher::Match> matches;
+    matcher.FindAll(text, matches);
+    MatchSet out;
+    for (const auto &m : matches) out.insert({m.start, m.length});
+    return out;
+}
+
+static WordMatcher Build(const vector<string> &words) {
+    WordMatcher matcher;
+    matcher.Build(words);
+    return matcher;
+}
+
+// Same splitting as GlobalConfig::ParsePatterns
+static vector<string> SplitWords(const string &combined) {
+    vector<string> words;
+    stringstream ss(combined);
+    string item;
+    while (getline(ss, item, ',')) {
+        item.erase(0, item.find_first_not_of(" \t\n\r"));
+        item.erase(item.find_last_not_of(" \t\n\r") + 1);
+        if (!item.empty()) words.push_back(item);
+    }
+    return words;
+}
+
+static vector<string> LoadBuiltinWords() {
+    ifstream f(string(BENCH_DATA_DIR) + "/builtin_dirty_words.txt", ios::binary);
+    stringstream ss;
+    ss << f.rdbuf();
+    return SplitWords(ss.str());
+}
+
+// Random CJK words of 2-4 characters
+static vector<string> RandomWords(Lcg &rng, size_t count) {
+    vector<string> words;
+    for (size_t i = 0; i < count; i++) {
+        string w;
+        size_t chars = 2 + rng.Below(3);
+        for (size_t c = 0; c < chars; c++) AppendUtf8(w, 0x4E00 + rng.Below(0x51A6));
+        words.push_back(w);
+    }
+    return words;
+}
+
+// Random CJK text of about bytes bytes with every words[i] for i % every == 0 embedded
+static string RandomText(Lcg &rng, const vector<string> &words, size_t bytes, size_t every) {
+    string text;
+    size_t next_word = 0;
+    while (text.size() < bytes) {
+        if (rng.Below(8) == 0 && next_word < words.size()) {
+            text += words[next_word];
+            next_word += every;
+        } else {
+            AppendUtf8(text, 0x4E00 + rng.Below(0x51A6));
+        }
+    }
+    return text;
+}
+
+static void CheckBasics() {
+    // Byte offsets of a CJK literal
+    MatchSet m = Find(Build({"傻逼"}), "你这个傻逼啊");
+    CHECK(m == MatchSet({{9, 6}}));
+
+    // ASCII case folding both ways, like std::regex::icase on narrow strings
+    WordMatcher ascii = Build({"SB", "nmsl"});
+    CHECK(Find(ascii, "sb Sb sB") == MatchSet({{0, 2}, {3, 2}, {6, 2}}));
+    CHECK(Find(ascii, "NMSL") == MatchSet({{0, 4}}));
+
+    // Overlapping literals and literals inside other literals all report
+    CHECK(Find(Build({"他妈", "他妈的", "妈的"}), "他妈的") == MatchSet({{0, 6}, {0, 9}, {3, 6}}));
+    CHECK(Find(Build({"哈哈"}), "哈哈哈") == MatchSet({{0, 6}, {3, 6}}));
+
+    // A literal ending at the last byte and one at the first
+    CHECK(Find(Build({"滚", "垃圾"}), "滚开垃圾") == MatchSet({{0, 3}, {6, 6}}));
+
+    // Empty input and empty word list
+    CHECK(Find(Build({"操"}), "").empty());
+    CHECK(Find(Build({}), "操").empty());
+    CHECK(Build({"", "操"}).LiteralCount() == 1);
+}
+
+static void CheckRegexFallback() {
+    CHECK(WordMatcher::IsRegexWord("f.ck"));
+    CHECK(WordMatcher::IsRegexWord("s[b8]"));
+    CHECK(!WordMatcher::IsRegexWord("傻逼"));
+    CHECK(!WordMatcher::IsRegexWord("SB"));
+
+    WordMatcher mixed = Build({"傻逼", "f.ck", "s[b8]"});
+    CHECK(mixed.LiteralCount() == 1);
+    CHECK(mixed.RegexCount() == 2);
+    CHECK(mixed.MaxMatchChars() == SIZE_MAX);
+    CHECK(Find(mixed, "FUCK 傻逼 s8") == MatchSet({{0, 4}, {5, 6}, {12, 2}}));
+
+    // An invalid regex is dropped without affecting the rest
+    WordMatcher invalid = Build({"(", "操"});
+    CHECK(invalid.RegexCount() == 0);
+    CHECK(Find(invalid, "操") == MatchSet({{0, 3}}));
+
+    // Without regex entries the longest literal bounds the match length in characters
+    CHECK(Build({"操", "操你大爷"}).MaxMatchChars() == 4);
+}
+
+// Every literal occurrence the automaton reports is real, none is missed, and the old per-word regex
+// scan (non-overlapping per word) only ever finds a subset of them
+static void CheckAgainstReference() {
+    Lcg rng;
+    vector<string> words = RandomWords(rng, 300);
+    // A small alphabet makes repeats and overlaps common
+    vector<string> alphabet = {"你", "妈", "的", "他", "操", "傻", "逼"};
+    for (size_t i = 0; i < 50; i++) {
+        string w;
+        size_t chars = 1 + rng.Below(3);
+        for (size_t c = 0; c < chars; c++) w += alphabet[rng.Below((uint32_t)alphabet.size())];
+        words.push_back(w);
+    }
+    WordMatcher matcher = Build(words);
+
+    for (int round = 0; round < 20; round++) {
+        string text;
+        for (size_t i = 0; i < 200; i++) {
+            if (rng.Below(4) == 0) text += words[rng.Below((uint32_t)words.size())];
+            else text += alphabet[rng.Below((uint32_t)alphabet.size())];
+        }
+        MatchSet found = Find(matcher, text);
+
+        MatchSet brute;
+        for (const auto &w : words) {
+            for (size_t pos = text.find(w); pos != string::npos; pos = text.find(w, pos + 1)) {
+                if ((text[pos] & 0xC0) != 0x80) brute.insert({pos, w.size()});
+            }
+        }
+        CHECK(found == brute);
+
+        for (const auto &w : words) {
+            regex re(w, regex::icase);
+            for (sregex_iterator it(text.begin(), text.end(), re), end; it != end; ++it) {
+                CHECK(found.count({(size_t)it->position(), (size_t)it->length()}) == 1);
+            }
+        }
+    }
+}
+
+// Built-in list plus random custom words over one transcript-sized text, as in a busy ASR chunk
+static void RunTimings() {
+    Lcg rng;
+    vector<string> words = LoadBuiltinWords();
+    size_t builtin = words.size();
+    vector<string> custom = RandomWords(rng, 3000);
+    words.insert(words.end(), custom.begin(), custom.end());
+    string text = RandomText(rng, words, 600, 97);
+
+    vector<regex> patterns;
+    double regex_build = TimeUs([&] {
+        patterns.clear();
+        for (const auto &w : words) patterns.emplace_back(w, regex::icase);
+    }, 0.5);
+    WordMatcher matcher;
+    double automaton_build = TimeUs([&] { matcher.Build(words); }, 0.5);
+
+    size_t regex_matches = 0;
+    double regex_scan = TimeUs([&] {
+        regex_matches = 0;
+        for (const auto &re : patterns) {
+            for (sregex_iterator it(text.begin(), text.end(), re), end; it != end; ++it) regex_matches++;
+        }
+    }, 1.0);
+    vector<WordMatcher::Match> matches;
+    double automaton_scan = TimeUs([&] {
+        matches.clear();
+        matcher.FindAll(text, matches);
+    });
+
+    printf("%zu words (%zu built-in + %zu random), %zu-byte transcript\n", words.size(), builtin, custom.size(), text.size());
+    printf("  build:          std::regex %9.1f us   automaton %9.1f us\n", regex_build, automaton_build);
+    printf("  scan per chunk: std::regex %9.1f us   automaton %9.1f us   (%.0fx)\n", regex_scan, automaton_scan,
+        regex_scan / automaton_scan);
+    printf("  matches:        std::regex %9zu      automaton %9zu\n", regex_matches, matches.size());
+}
+
+int main(int argc, char **argv) {
+    CheckBasics();
+    CheckRegexFallback();
+    CheckAgainstReference();
+    int result = CheckResult("word-matcher");
+    if (result == 0 && TimingsWanted(argc, argv)) RunTimings();
+    return result;
+}
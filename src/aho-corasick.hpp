@@ -0,0 +1,172 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Aho-Corasick automaton over an arbitrary integral symbol type.
+// Used with bytes (UTF-8 dirty words) and with interned pinyin syllable IDs.
+// Add() all patterns, Compile() once, then Scan() finds every occurrence in a single pass.
+template <typename Symbol>
+class AhoCorasick {
+public:
+    AhoCorasick() { Clear(); }
+
+    void Clear() {
+        build_.assign(1, BuildNode{});
+        nodes_.clear();
+        edges_.clear();
+        pattern_lengths_.clear();
+        max_pattern_length_ = 0;
+    }
+
+    // Returns the pattern id (index in insertion order). Empty patterns are ignored (returns -1).
+    int32_t Add(const Symbol *seq, size_t len) {
+        if (len == 0) return -1;
+        int32_t state = 0;
+        for (size_t i = 0; i < len; i++) {
+            auto &next = build_[state].next;
+            auto it = std::lower_bound(next.begin(), next.end(), seq[i],
+                [](const std::pair<Symbol, int32_t> &e, Symbol s) { return e.first < s; });
+            if (it != next.end() && it->first == seq[i]) {
+                state = it->second;
+            } else {
+                int32_t child = (int32_t)build_.size();
+                next.insert(it, {seq[i], child});
+                build_.push_back(BuildNode{});
+                state = child;
+            }
+        }
+        int32_t id = (int32_t)pattern_lengths_.size();
+        pattern_lengths_.push_back(len);
+        max_pattern_length_ = std::max(max_pattern_length_, len);
+        if (build_[state].output < 0) build_[state].output = id; // Duplicate patterns report the first id
+        return id;
+    }
+
+    // Computes failure/dictionary links and flattens the trie into contiguous arrays
+    void Compile() {
+        std::vector<int32_t> fail(build_.size(), 0);
+        std::vector<int32_t> dict(build_.size(), -1);
+        std::vector<uint32_t> depth(build_.size(), 0);
+
+        // Breadth-first, so every failure target is finalized before its dependents
+        std::deque<int32_t> queue;
+        for (const auto &e : build_[0].next) {
+            depth[e.second] = 1;
+            queue.push_back(e.second);
+        }
+        while (!queue.empty()) {
+            int32_t u = queue.front();
+            queue.pop_front();
+            for (const auto &e : build_[u].next) {
+                int32_t v = e.second;
+                depth[v] = depth[u] + 1;
+                int32_t f = fail[u];
+                int32_t target = 0;
+                while (true) {
+                    int32_t c = FindBuildChild(f, e.first);
+                    if (c >= 0) { target = c; break; }
+                    if (f == 0) break;
+                    f = fail[f];
+                }
+                fail[v] = target;
+                dict[v] = (build_[target].output >= 0) ? target : dict[target];
+                queue.push_back(v);
+            }
+        }
+
+        nodes_.assign(build_.size(), Node{});
+        edges_.clear();
+        for (size_t i = 0; i < build_.size(); i++) {
+            nodes_[i].edge_begin = (uint32_t)edges_.size();
+            nodes_[i].edge_count = (uint32_t)build_[i].next.size();
+            nodes_[i].fail = fail[i];
+            nodes_[i].dict = dict[i];
+            nodes_[i].output = build_[i].output;
+            nodes_[i].depth = depth[i];
+            edges_.insert(edges_.end(), build_[i].next.begin(), build_[i].next.end());
+        }
+        build_.clear();
+        build_.shrink_to_fit();
+    }
+
+    // Advances the automaton by one symbol
+    int32_t Step(int32_t state, Symbol s) const {
+        while (true) {
+            int32_t c = FindChild(state, s);
+            if (c >= 0) return c;
+            if (state == 0) return 0;
+            state = nodes_[state].fail;
+        }
+    }
+
+    // Length of the pattern prefix the state represents (0 = root)
+    size_t Depth(int32_t state) const { return nodes_[state].depth; }
+
+    // Reports every pattern ending at the given state: on_match(pattern_id, pattern_length)
+    template <typename F>
+    void ForEachOutput(int32_t state, F &&on_match) const {
+        int32_t s = (nodes_[state].output >= 0) ? state : nodes_[state].dict;
+        while (s >= 0) {
+            int32_t id = nodes_[s].output;
+            on_match(id, pattern_lengths_[id]);
+            s = nodes_[s].dict;
+        }
+    }
+
+    // Single pass over text: on_match(pattern_id, start_index, length)
+    template <typename F>
+    void Scan(const Symbol *text, size_t len, F &&on_match) const {
+        if (nodes_.empty()) return;
+        int32_t state = 0;
+        for (size_t i = 0; i < len; i++) {
+            state = Step(state, text[i]);
+            ForEachOutput(state, [&](int32_t id, size_t plen) { on_match(id, i + 1 - plen, plen); });
+        }
+    }
+
+    bool Empty() const { return pattern_lengths_.empty(); }
+    size_t PatternCount() const { return pattern_lengths_.size(); }
+    size_t MaxPatternLength() const { return max_pattern_length_; }
+
+private:
+    struct BuildNode {
+        std::vector<std::pair<Symbol, int32_t>> next; // Sorted by symbol
+        int32_t output = -1;
+    };
+
+    struct Node {
+        uint32_t edge_begin = 0;
+        uint32_t edge_count = 0;
+        int32_t fail = 0;
+        int32_t dict = -1;   // Nearest node on the failure chain that ends a pattern
+        int32_t output = -1; // Pattern ending exactly here
+        uint32_t depth = 0;
+    };
+
+    int32_t FindBuildChild(int32_t state, Symbol s) const {
+        const auto &next = build_[state].next;
+        auto it = std::lower_bound(next.begin(), next.end(), s,
+            [](const std::pair<Symbol, int32_t> &e, Symbol sym) { return e.first < sym; });
+        return (it != next.end() && it->first == s) ? it->second : -1;
+    }
+
+    int32_t FindChild(int32_t state, Symbol s) const {
+        const Node &n = nodes_[state];
+        auto begin = edges_.begin() + n.edge_begin;
+        auto end = begin + n.edge_count;
+        auto it = std::lower_bound(begin, end, s,
+            [](const std::pair<Symbol, int32_t> &e, Symbol sym) { return e.first < sym; });
+        return (it != end && it->first == s) ? it->second : -1;
+    }
+
+    std::vector<BuildNode> build_;
+    std::vector<Node> nodes_;
+    std::vector<std::pair<Symbol, int32_t>> edges_;
+    std::vector<size_t> pattern_lengths_;
+    size_t max_pattern_length_ = 0;
+};
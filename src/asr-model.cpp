@@ -2,17 +2,70 @@
 #include <obs.h>
 #include <cstring>
 #include <cstdio>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
 #include "logging-macros.hpp"
+#include "word-matcher.hpp"
+#include "utils.hpp"
+#include "graph-optimizer.hpp"
+#include <chrono>
 
-ASRModel::ASRModel(const std::string& path, std::string& error_msg) : model_path(path) {
-    SherpaOnnxOnlineRecognizerConfig config;
-    memset(&config, 0, sizeof(config));
-    
-    config.feat_config.sample_rate = 16000;
-    config.feat_config.feature_dim = 80;
+static bool IsInt8File(const std::string& name) {
+    static const std::string kSuffix = ".int8.onnx";
+    return name.size() > kSuffix.size() && name.compare(name.size() - kSuffix.size(), kSuffix.size(), kSuffix) == 0;
+}
+
+// <prefix>-epoch-99-avg-1<ext>, <prefix><ext>, then any <prefix>*<ext> (KWS releases use e.g.
+// encoder-epoch-12-avg-2-chunk-16-left-64.onnx), where ext is .int8.onnx or .onnx. Empty if none exists.
+static std::string FindModelVariant(const std::string& dir, const std::string& prefix, bool int8) {
+    std::string ext = int8 ? ".int8.onnx" : ".onnx";
+    for (const std::string& name : {prefix + "-epoch-99-avg-1" + ext, prefix + ext}) {
+        std::string candidate = dir + "/" + name;
+        FILE *f = fopen(candidate.c_str(), "r");
+        if (f) {
+            fclose(f);
+            return candidate;
+        }
+    }
     
+    std::string found;
+    try {
+        for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+            std::string name = entry.path().filename().string();
+            bool ext_ok = name.size() > 5 && name.compare(name.size() - 5, 5, ".onnx") == 0 && IsInt8File(name) == int8;
+            if (name.rfind(prefix, 0) == 0 && ext_ok) {
+                // Deterministic choice regardless of directory order
+                if (found.empty() || name < found) found = name;
+            }
+        }
+    } catch(...) {}
+    return found.empty() ? "" : dir + "/" + found;
+}
+
+// The requested variant if the package ships it, otherwise the other one
+static std::string FindModelFile(const std::string& dir, const std::string& prefix, bool prefer_int8) {
+    std::string file = FindModelVariant(dir, prefix, prefer_int8);
+    return file.empty() ? FindModelVariant(dir, prefix, !prefer_int8) : file;
+}
+
+static uint64_t FileSize(const std::string& path) {
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(path, ec);
+    return ec ? 0 : size;
+}
+
+std::string EngineOptions::Key() const {
+    char buf[160];
+    snprintf(buf, sizeof(buf), "%d|%s|%s|%d|%.2f|%.2f|%d", num_threads, provider.c_str(), decoding_method.c_str(),
+             max_active_paths, rule1_min_trailing_silence, rule2_min_trailing_silence, prefer_int8 ? 1 : 0);
+    return buf;
+}
+
+ASRModel::ASRModel(const std::string& path, EngineMode engine_mode, const std::vector<std::string>& words,
+                   const EngineOptions& engine_options, std::string& error_msg)
+    : model_path(path), mode(engine_mode), options(engine_options) {
     std::string tokens = model_path + "/tokens.txt";
-    std::string encoder = model_path + "/encoder-epoch-99-avg-1.onnx";
     
     // Check files existence
     FILE *f = fopen(tokens.c_str(), "r");
@@ -22,64 +75,138 @@ ASRModel::ASRModel(const std::string& path, std::string& error_msg) : model_path
     }
     fclose(f);
 
-    f = fopen(encoder.c_str(), "r");
-    if (f) { fclose(f); } else { 
-        encoder = model_path + "/encoder.onnx"; 
-        f = fopen(encoder.c_str(), "r");
-        if (!f) {
-            error_msg = "文件缺失: encoder.onnx (或 epoch-99)";
-            return;
-        }
-        fclose(f);
+    std::string encoder = FindModelFile(model_path, "encoder", options.prefer_int8);
+    if (encoder.empty()) {
+        error_msg = "文件缺失: encoder.onnx (或 epoch-99)";
+        return;
     }
     
-    std::string decoder = model_path + "/decoder-epoch-99-avg-1.onnx";
-    f = fopen(decoder.c_str(), "r");
-    if (f) { fclose(f); } else { 
-        decoder = model_path + "/decoder.onnx"; 
-        f = fopen(decoder.c_str(), "r");
-        if (!f) {
-            error_msg = "文件缺失: decoder.onnx (或 epoch-99)";
-            return;
+    std::string decoder = FindModelFile(model_path, "decoder", options.prefer_int8);
+    if (decoder.empty()) {
+        error_msg = "文件缺失: decoder.onnx (或 epoch-99)";
+        return;
+    }
+    
+    std::string joiner = FindModelFile(model_path, "joiner", options.prefer_int8);
+    if (joiner.empty()) {
+        error_msg = "文件缺失: joiner.onnx (或 epoch-99)";
+        return;
+    }
+    
+    // Startup cost of this variant, logged with the load result (compare int8 and fp32 runs)
+    int int8_files = IsInt8File(encoder) + IsInt8File(decoder) + IsInt8File(joiner);
+    variant = int8_files == 3 ? "int8" : int8_files == 0 ? "fp32" : "int8/fp32";
+    disk_bytes = (size_t)(FileSize(encoder) + FileSize(decoder) + FileSize(joiner));
+    
+    // Graphs saved by the GraphOptimizer skip most of ONNX Runtime's optimization passes. CPU only: the fused
+    // operators they contain are CPU kernels, other providers get the original graph.
+    if (options.provider == "cpu") {
+        std::string opt_encoder = GraphOptimizer::Prefer(encoder);
+        std::string opt_decoder = GraphOptimizer::Prefer(decoder);
+        std::string opt_joiner = GraphOptimizer::Prefer(joiner);
+        if (opt_encoder != encoder && opt_decoder != decoder && opt_joiner != joiner) {
+            encoder = opt_encoder;
+            decoder = opt_decoder;
+            joiner = opt_joiner;
+            variant += "+opt";
         }
-        fclose(f);
     }
+    size_t ram_before = GetProcessPrivateBytes();
+    auto load_start = std::chrono::steady_clock::now();
+    auto log_load = [&](const char *kind) {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_start).count();
+        double ram_mb = ((double)GetProcessPrivateBytes() - (double)ram_before) / (1024.0 * 1024.0);
+        resident_bytes = (ram_mb > 0.0) ? (size_t)(ram_mb * 1024.0 * 1024.0) : (size_t)disk_bytes;
+        BLOG(LOG_INFO, "%s Model Loaded: %s [%s, %.0f MB on disk, +%.0f MB RAM, %.0f ms]", kind, model_path.c_str(),
+             variant.c_str(), disk_bytes / (1024.0 * 1024.0), ram_mb, ms);
+    };
+    
+    SherpaOnnxOnlineModelConfig model_config;
+    memset(&model_config, 0, sizeof(model_config));
+    model_config.transducer.encoder = encoder.c_str();
+    model_config.transducer.decoder = decoder.c_str();
+    model_config.transducer.joiner = joiner.c_str();
+    model_config.tokens = tokens.c_str();
+    model_config.num_threads = options.num_threads > 0 ? options.num_threads : 1;
+    model_config.provider = options.provider.c_str();
     
-    std::string joiner = model_path + "/joiner-epoch-99-avg-1.onnx";
-    f = fopen(joiner.c_str(), "r");
-    if (f) { fclose(f); } else { 
-        joiner = model_path + "/joiner.onnx"; 
-        f = fopen(joiner.c_str(), "r");
-        if (!f) {
-            error_msg = "文件缺失: joiner.onnx (或 epoch-99)";
+    if (mode == EngineMode::KeywordSpotter) {
+        LoadTokenSet(tokens);
+        size_t skipped = 0;
+        std::string keywords = BuildKeywords(words, &skipped);
+        if (keywords.empty()) {
+            error_msg = "关键词模式: 脏话列表中没有可用于该模型的词";
             return;
         }
-        fclose(f);
+        
+        SherpaOnnxKeywordSpotterConfig config;
+        memset(&config, 0, sizeof(config));
+        config.feat_config.sample_rate = 16000;
+        config.feat_config.feature_dim = 80;
+        config.model_config = model_config;
+        config.max_active_paths = options.max_active_paths;
+        config.num_trailing_blanks = 1;
+        config.keywords_score = 1.0f;
+        config.keywords_threshold = 0.25f;
+        // Spotter needs a non-empty default list, streams get the live list via CreateStream
+        config.keywords_buf = keywords.c_str();
+        config.keywords_buf_size = (int32_t)keywords.size();
+        
+        keyword_spotter = SherpaOnnxCreateKeywordSpotter(&config);
+        if (!keyword_spotter && options.provider != "cpu") {
+            BLOG(LOG_WARNING, "Provider '%s' unavailable, falling back to cpu", options.provider.c_str());
+            config.model_config.provider = "cpu";
+            keyword_spotter = SherpaOnnxCreateKeywordSpotter(&config);
+        }
+        if (!keyword_spotter) {
+            error_msg = "关键词引擎创建失败 (模型可能不是 KWS 模型)";
+        } else {
+            log_load("KWS");
+            BLOG(LOG_INFO, "KWS keywords: %zu words skipped (not representable in model tokens)", skipped);
+        }
+        return;
     }
     
-    config.model_config.transducer.encoder = encoder.c_str();
-    config.model_config.transducer.decoder = decoder.c_str();
-    config.model_config.transducer.joiner = joiner.c_str();
-    config.model_config.tokens = tokens.c_str();
-    config.model_config.num_threads = 1;
-    config.model_config.provider = "cpu";
+    SherpaOnnxOnlineRecognizerConfig config;
+    memset(&config, 0, sizeof(config));
+    
+    config.feat_config.sample_rate = 16000;
+    config.feat_config.feature_dim = 80;
+    config.model_config = model_config;
+    
+    // modified_beam_search is more accurate on short phrases (and needed for hotwords), greedy_search is cheaper
+    config.decoding_method = options.decoding_method.c_str();
+    config.max_active_paths = options.max_active_paths;
     
-    // Use modified_beam_search for better accuracy on short phrases
-    config.decoding_method = "modified_beam_search"; 
-    config.max_active_paths = 4;
+    // Hotwords (contextual biasing) are passed per stream, the recognizer only needs to know how to tokenize them
+    LoadTokenSet(tokens);
+    std::string bpe_vocab = model_path + "/bpe.vocab";
+    has_bpe_ = std::filesystem::exists(bpe_vocab);
+    config.model_config.modeling_unit = has_bpe_ ? "cjkchar+bpe" : "cjkchar";
+    config.model_config.bpe_vocab = has_bpe_ ? bpe_vocab.c_str() : "";
+    config.hotwords_score = 1.5f;
     
     // Enable Endpoint detection to reset state after silence
     // This helps with recognition consistency for isolated phrases
     config.enable_endpoint = 1;
-    config.rule1_min_trailing_silence = 2.4f;
-    config.rule2_min_trailing_silence = 1.2f;
+    config.rule1_min_trailing_silence = options.rule1_min_trailing_silence;
+    config.rule2_min_trailing_silence = options.rule2_min_trailing_silence;
     config.rule3_min_utterance_length = 0.0f;
     
     recognizer = SherpaOnnxCreateOnlineRecognizer(&config);
+    if (!recognizer && options.provider != "cpu") {
+        BLOG(LOG_WARNING, "Provider '%s' unavailable, falling back to cpu", options.provider.c_str());
+        config.model_config.provider = "cpu";
+        recognizer = SherpaOnnxCreateOnlineRecognizer(&config);
+    }
     if (!recognizer) {
         error_msg = "引擎创建失败 (内部错误)";
     } else {
-        BLOG(LOG_INFO, "ASR Model Loaded: %s", model_path.c_str());
+        log_load("ASR");
+        BLOG(LOG_INFO, "ASR settings: %d threads, %s, %s", model_config.num_threads, config.model_config.provider,
+             options.decoding_method.c_str());
+        // Vocabulary is fixed per model, precompute token -> pinyin once
+        pinyin_table = TokenPinyinTable::LoadOrBuild(model_path);
     }
 }
 
@@ -88,31 +215,427 @@ ASRModel::~ASRModel() {
         SherpaOnnxDestroyOnlineRecognizer(recognizer);
         BLOG(LOG_INFO, "ASR Model Unloaded: %s", model_path.c_str());
     }
+    if (keyword_spotter) {
+        SherpaOnnxDestroyKeywordSpotter(keyword_spotter);
+        BLOG(LOG_INFO, "KWS Model Unloaded: %s", model_path.c_str());
+    }
+}
+
+// --- Engine-agnostic stream operations ---
+
+const SherpaOnnxOnlineStream *ASRModel::CreateStream(const std::string& context) const {
+    if (keyword_spotter) {
+        if (context.empty()) return SherpaOnnxCreateKeywordStream(keyword_spotter);
+        return SherpaOnnxCreateKeywordStreamWithKeywords(keyword_spotter, context.c_str());
+    }
+    if (!recognizer) return nullptr;
+    if (context.empty()) return SherpaOnnxCreateOnlineStream(recognizer);
+    return SherpaOnnxCreateOnlineStreamWithHotwords(recognizer, context.c_str());
+}
+
+const SherpaOnnxOnlineStream *ASRModel::CreateStreamFor(const std::vector<std::string>& words, float hotword_score, size_t *skipped) const {
+    if (skipped) *skipped = 0;
+    if (keyword_spotter) return CreateStream(BuildKeywords(words, skipped));
+    // Hotwords only take effect in beam search
+    if (hotword_score <= 0.0f || options.decoding_method != "modified_beam_search") return CreateStream();
+    return CreateStream(BuildHotwords(words, hotword_score, skipped));
+}
+
+void ASRModel::ResetStream(const SherpaOnnxOnlineStream *stream) const {
+    if (keyword_spotter) SherpaOnnxResetKeywordStream(keyword_spotter, stream);
+    else SherpaOnnxOnlineStreamReset(recognizer, stream);
+}
+
+bool ASRModel::IsReady(const SherpaOnnxOnlineStream *stream) const {
+    if (keyword_spotter) return SherpaOnnxIsKeywordStreamReady(keyword_spotter, stream) != 0;
+    return SherpaOnnxIsOnlineStreamReady(recognizer, stream) != 0;
+}
+
+void ASRModel::Decode(const SherpaOnnxOnlineStream **streams, int32_t n) const {
+    if (n == 1) {
+        if (keyword_spotter) SherpaOnnxDecodeKeywordStream(keyword_spotter, streams[0]);
+        else SherpaOnnxDecodeOnlineStream(recognizer, streams[0]);
+        return;
+    }
+    if (keyword_spotter) SherpaOnnxDecodeMultipleKeywordStreams(keyword_spotter, streams, n);
+    else SherpaOnnxDecodeMultipleOnlineStreams(recognizer, streams, n);
+}
+
+double ASRModel::WarmUp() const {
+    auto start = std::chrono::steady_clock::now();
+    const SherpaOnnxOnlineStream *stream = CreateStream();
+    if (!stream) return 0.0;
+    
+    // Quiet noise rather than zeros, so the search runs the way it does on real input
+    std::vector<float> samples(16000);
+    uint32_t seed = 12345;
+    for (float &s : samples) {
+        seed = seed * 1664525u + 1013904223u;
+        s = ((float)(seed >> 8) / (float)(1u << 24) - 0.5f) * 0.02f;
+    }
+    SherpaOnnxOnlineStreamAcceptWaveform(stream, 16000, samples.data(), (int32_t)samples.size());
+    SherpaOnnxOnlineStreamInputFinished(stream);
+    while (IsReady(stream)) {
+        Decode(&stream, 1);
+    }
+    SherpaOnnxDestroyOnlineStream(stream);
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// --- Keyword list generation (KWS) ---
+
+void ASRModel::LoadTokenSet(const std::string& tokens_path) {
+    std::ifstream f(tokens_path);
+    std::string line;
+    while (std::getline(f, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t sp = line.find_last_of(' ');
+        if (sp == std::string::npos || sp == 0) continue;
+        token_set_.insert(line.substr(0, sp));
+    }
+}
+
+// Splits a tone-marked syllable the way sherpa-onnx's text2token does for ppinyin models
+// (pypinyin non-strict: y/w count as initials), e.g. "zhōng" -> "zh" "ōng"
+static void SplitPinyin(const std::string& syllable, std::vector<std::string>& out) {
+    static const char *kInitials[] = {"zh", "ch", "sh", "b", "p", "m", "f", "d", "t", "n", "l", "g", "k", "h",
+                                      "j", "q", "x", "r", "z", "c", "s", "y", "w"};
+    for (const char *ini : kInitials) {
+        size_t len = strlen(ini);
+        if (syllable.size() > len && syllable.compare(0, len, ini) == 0) {
+            out.push_back(ini);
+            out.push_back(syllable.substr(len));
+            return;
+        }
+    }
+    out.push_back(syllable);
+}
+
+std::string ASRModel::BuildKeywords(const std::vector<std::string>& words, size_t *skipped) const {
+    // Keyword line: "<token> <token> ... @<word>". Two vocabularies are supported:
+    // cjkchar (every hanzi is a token) and ppinyin (initials + tone-marked finals).
+    std::string out;
+    std::vector<std::string> toks;
+    std::vector<std::string> syllables;
+    size_t skip_count = 0;
+    
+    for (const auto& w : words) {
+        if (w.empty() || WordMatcher::IsRegexWord(w) || w.find_first_of(" \t@:#") != std::string::npos) {
+            skip_count++;
+            continue;
+        }
+        
+        // cjkchar: split into UTF-8 code points
+        toks.clear();
+        bool ok = true;
+        for (size_t i = 0; i < w.size();) {
+            unsigned char c = (unsigned char)w[i];
+            size_t n = (c < 0x80) ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : 4;
+            toks.push_back(w.substr(i, n));
+            if (!token_set_.count(toks.back())) ok = false;
+            i += n;
+        }
+        
+        // ppinyin: tone-marked pinyin split into initial/final
+        if (!ok) {
+            syllables.clear();
+            PinyinEngine::Instance().ToTonedPinyin(w, syllables);
+            toks.clear();
+            for (const auto& syl : syllables) SplitPinyin(syl, toks);
+            ok = !toks.empty();
+            for (const auto& t : toks) {
+                if (!token_set_.count(t)) { ok = false; break; }
+            }
+        }
+        
+        if (!ok) {
+            skip_count++;
+            continue;
+        }
+        for (const auto& t : toks) out += t + " ";
+        out += "@" + w + "\n";
+    }
+    
+    if (skipped) *skipped = skip_count;
+    return out;
+}
+
+std::string ASRModel::BuildHotwords(const std::vector<std::string>& words, float score, size_t *skipped) const {
+    // sherpa-onnx splits cjkchar hotwords into characters itself; a character missing from tokens.txt would
+    // make it drop the whole list, so such words are filtered here
+    std::string out;
+    size_t skip_count = 0;
+    char score_buf[32];
+    snprintf(score_buf, sizeof(score_buf), " :%.1f\n", score);
+    
+    for (const auto& w : words) {
+        if (w.empty() || WordMatcher::IsRegexWord(w) || w.find_first_of("\t:#\n") != std::string::npos) {
+            skip_count++;
+            continue;
+        }
+        
+        std::string hotword;
+        bool ok = true;
+        for (size_t i = 0; i < w.size() && ok;) {
+            unsigned char c = (unsigned char)w[i];
+            size_t n = (c < 0x80) ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : 4;
+            if (n == 1) {
+                // ASCII only has tokens in BPE vocabularies, which are upper case
+                ok = has_bpe_;
+                hotword += (char)toupper(c);
+            } else {
+                ok = token_set_.count(w.substr(i, n)) > 0;
+                hotword += w.substr(i, n);
+            }
+            i += n;
+        }
+        
+        if (!ok) {
+            skip_count++;
+            continue;
+        }
+        out += hotword + score_buf;
+    }
+    
+    if (skipped) *skipped = skip_count;
+    return out;
 }
 
 std::map<std::string, std::weak_ptr<ASRModel>> ModelManager::models_;
 std::mutex ModelManager::mutex_;
+std::mutex ModelManager::loader_mutex_;
+std::condition_variable ModelManager::loader_cv_;
+std::deque<ModelManager::LoadRequest> ModelManager::load_queue_;
+std::map<std::string, std::shared_future<ModelLoad>> ModelManager::loads_in_flight_;
+std::thread ModelManager::loader_;
+bool ModelManager::loader_stop_ = false;
+std::list<ModelManager::Retained> ModelManager::retained_;
+std::chrono::seconds ModelManager::retention_ttl_{600};
+size_t ModelManager::retention_budget_bytes_ = (size_t)1024 * 1024 * 1024;
+ModelManager::CacheStats ModelManager::stats_;
 
-std::shared_ptr<ASRModel> ModelManager::Get(const std::string& path, std::string& error_out) {
-    std::lock_guard<std::mutex> lock(mutex_);
+// How often the loader thread checks retained models for expiry
+static constexpr auto kRetentionCheckPeriod = std::chrono::seconds(10);
+
+std::string ModelManager::Key(const std::string& path, EngineMode mode, const EngineOptions& options) {
+    // Same folder can be loaded as recognizer and as keyword spotter, and with different settings
+    return ((mode == EngineMode::KeywordSpotter) ? path + "|kws" : path) + "|" + options.Key();
+}
+
+std::shared_ptr<ASRModel> ModelManager::Get(const std::string& path, EngineMode mode, const std::vector<std::string>& words,
+                                             const EngineOptions& options, std::string& error_out) {
+    std::string key = Key(path, mode, options);
     
     // Check if already loaded
-    auto it = models_.find(path);
-    if (it != models_.end()) {
-        auto ptr = it->second.lock();
-        if (ptr) {
-            return ptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = models_.find(key);
+        if (it != models_.end()) {
+            auto ptr = it->second.lock();
+            if (ptr) {
+                Touch(key, ptr);
+                return ptr;
+            }
+            models_.erase(it);
         }
-        models_.erase(it);
     }
     
-    // Load new
+    // Load new, without the lock so cache lookups never wait on a load in progress
     BLOG(LOG_INFO, "🆕 [ModelManager] Loading NEW model for: %s", path.c_str());
-    auto ptr = std::make_shared<ASRModel>(path, error_out);
-    if (!ptr->recognizer) {
+    auto ptr = std::make_shared<ASRModel>(path, mode, words, options, error_out);
+    if (!ptr->IsValid()) {
         return nullptr; // Failed
     }
+    BLOG(LOG_INFO, "[ModelManager] Warm-up decode: %.0f ms", ptr->WarmUp());
     
-    models_[path] = ptr;
+    std::vector<std::shared_ptr<ASRModel>> evicted;
+    std::lock_guard<std::mutex> lock(mutex_);
+    // A concurrent Get may have loaded the same model meanwhile, keep a single instance
+    auto existing = models_[key].lock();
+    if (existing) {
+        Touch(key, existing);
+        return existing;
+    }
+    models_[key] = ptr;
+    stats_.misses++;
+    retained_.push_front({key, ptr, std::chrono::steady_clock::now()});
+    Evict(evicted); // The new model may push idle ones over the budget
+    LogStats("loaded", path);
     return ptr;
 }
+
+std::shared_future<ModelLoad> ModelManager::LoadAsync(const std::string& path, EngineMode mode, const std::vector<std::string>& words,
+                                                       const EngineOptions& options) {
+    std::string key = Key(path, mode, options);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = models_.find(key);
+        if (it != models_.end()) {
+            auto ptr = it->second.lock();
+            if (ptr) {
+                Touch(key, ptr);
+                std::promise<ModelLoad> ready;
+                ready.set_value({ptr, ""});
+                return ready.get_future().share();
+            }
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(loader_mutex_);
+    auto it = loads_in_flight_.find(key);
+    if (it != loads_in_flight_.end()) return it->second;
+    
+    LoadRequest request{key, path, mode, words, options, std::promise<ModelLoad>()};
+    std::shared_future<ModelLoad> future = request.promise.get_future().share();
+    if (loader_stop_) {
+        request.promise.set_value({nullptr, "插件正在卸载"});
+        return future;
+    }
+    loads_in_flight_[key] = future;
+    load_queue_.push_back(std::move(request));
+    if (!loader_.joinable()) {
+        loader_ = std::thread(&ModelManager::LoaderLoop);
+    }
+    loader_cv_.notify_one();
+    return future;
+}
+
+void ModelManager::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(loader_mutex_);
+        loader_stop_ = true;
+    }
+    loader_cv_.notify_one();
+    if (loader_.joinable()) loader_.join();
+    
+    {
+        std::lock_guard<std::mutex> lock(loader_mutex_);
+        for (auto& request : load_queue_) {
+            request.promise.set_value({nullptr, "插件正在卸载"});
+        }
+        load_queue_.clear();
+        loads_in_flight_.clear();
+    }
+    
+    // Release retained models now, not during static destruction
+    std::list<Retained> released;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        released.swap(retained_);
+    }
+}
+
+void ModelManager::LoaderLoop() {
+    while (true) {
+        LoadRequest request;
+        {
+            std::unique_lock<std::mutex> lock(loader_mutex_);
+            loader_cv_.wait_for(lock, kRetentionCheckPeriod, [] { return loader_stop_ || !load_queue_.empty(); });
+            if (loader_stop_) return;
+            if (load_queue_.empty()) {
+                // Idle tick: expire retained models (destroyed outside both locks)
+                lock.unlock();
+                std::vector<std::shared_ptr<ASRModel>> evicted;
+                std::lock_guard<std::mutex> cache_lock(mutex_);
+                Evict(evicted);
+                continue;
+            }
+            request = std::move(load_queue_.front());
+            load_queue_.pop_front();
+        }
+        
+        ModelLoad load;
+        load.model = Get(request.path, request.mode, request.words, request.options, load.error);
+        if (!load.model && load.error.empty()) load.error = "引擎初始化失败";
+        
+        std::lock_guard<std::mutex> lock(loader_mutex_);
+        // Waiters hold the shared future, the in-flight entry only dedupes requests
+        loads_in_flight_.erase(request.key);
+        request.promise.set_value(std::move(load));
+    }
+}
+
+void ModelManager::SetRetention(int ttl_seconds, int budget_mb) {
+    std::vector<std::shared_ptr<ASRModel>> evicted;
+    std::lock_guard<std::mutex> lock(mutex_);
+    retention_ttl_ = std::chrono::seconds(ttl_seconds > 0 ? ttl_seconds : 0);
+    retention_budget_bytes_ = (size_t)(budget_mb > 0 ? budget_mb : 0) * 1024 * 1024;
+    Evict(evicted);
+}
+
+ModelManager::CacheStats ModelManager::Stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CacheStats stats = stats_;
+    size_t bytes = 0;
+    for (const auto& r : retained_) {
+        bytes += r.model->resident_bytes;
+        if (r.model->users.load() == 0) stats.idle++;
+    }
+    stats.models = retained_.size();
+    stats.resident_mb = bytes / (1024.0 * 1024.0);
+    return stats;
+}
+
+void ModelManager::Touch(const std::string& key, const std::shared_ptr<ASRModel>& model) {
+    stats_.hits++;
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = retained_.begin(); it != retained_.end(); ++it) {
+        if (it->key != key) continue;
+        if (it->model->users.load() == 0) {
+            // No filter used it: this hit is a reload saved by the retention
+            stats_.revived++;
+            double idle_s = std::chrono::duration<double>(now - it->last_used).count();
+            BLOG(LOG_INFO, "[ModelManager] Reusing retained model (idle %.0f s): %s", idle_s, model->model_path.c_str());
+        }
+        it->last_used = now;
+        retained_.splice(retained_.begin(), retained_, it);
+        return;
+    }
+    retained_.push_front({key, model, now});
+}
+
+void ModelManager::Evict(std::vector<std::shared_ptr<ASRModel>>& evicted) {
+    auto now = std::chrono::steady_clock::now();
+    size_t total = 0;
+    for (const auto& r : retained_) total += r.model->resident_bytes;
+    
+    // Oldest first: expired idle models, then idle models while over the budget
+    for (auto it = retained_.end(); it != retained_.begin(); ) {
+        --it;
+        if (it->model->users.load() > 0) continue;
+        bool expired = now - it->last_used >= retention_ttl_;
+        if (!expired && total <= retention_budget_bytes_) continue;
+        total -= it->model->resident_bytes;
+        stats_.evictions++;
+        std::string path = it->model->model_path;
+        evicted.push_back(std::move(it->model));
+        it = retained_.erase(it);
+        LogStats(expired ? "evicted (idle)" : "evicted (over budget)", path);
+    }
+}
+
+void ModelManager::Released(const ASRModel& model) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& r : retained_) {
+        if (r.model.get() == &model) {
+            r.last_used = std::chrono::steady_clock::now();
+            return;
+        }
+    }
+}
+
+void ModelHandle::reset() {
+    if (!model_) return;
+    if (model_->users.fetch_sub(1) == 1) ModelManager::Released(*model_);
+    model_.reset();
+}
+
+void ModelManager::LogStats(const char *event, const std::string& path) {
+    size_t bytes = 0;
+    for (const auto& r : retained_) bytes += r.model->resident_bytes;
+    uint64_t lookups = stats_.hits + stats_.misses;
+    BLOG(LOG_INFO, "[ModelManager] %s: %s | cache: %zu models, %.0f MB, hit rate %.0f%% (%llu hits, %llu reloads saved, %llu misses)",
+         event, path.c_str(), retained_.size(), bytes / (1024.0 * 1024.0),
+         lookups ? 100.0 * (double)stats_.hits / (double)lookups : 0.0,
+         (unsigned long long)stats_.hits, (unsigned long long)stats_.revived, (unsigned long long)stats_.misses);
+}
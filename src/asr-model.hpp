@@ -1,24 +1,184 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <map>
+#include <unordered_set>
 #include <memory>
+#include <atomic>
 #include <mutex>
+#include <deque>
+#include <list>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <condition_variable>
 #include "sherpa-onnx/c-api/c-api.h"
+#include "pinyin-engine.hpp"
+
+enum class EngineMode {
+    Transducer = 0,     // Full streaming ASR, transcript matched against the word list
+    KeywordSpotter = 1, // sherpa-onnx keyword spotter, only the word list is searched for
+};
+
+// Recognizer / spotter settings (GlobalConfig, resolved by AutoTuner for the fields left on auto).
+// Models built with different options are cached separately.
+struct EngineOptions {
+    int num_threads = 1;
+    std::string provider = "cpu";                        // cpu, xnnpack, directml, cuda (falls back to cpu)
+    std::string decoding_method = "modified_beam_search"; // or greedy_search (transducer only)
+    int max_active_paths = 4;
+    float rule1_min_trailing_silence = 2.4f;             // Endpoint rules (transducer only)
+    float rule2_min_trailing_silence = 1.2f;
+    bool prefer_int8 = true;                             // Use *.int8.onnx when the package ships them
+    
+    std::string Key() const;
+    bool operator==(const EngineOptions& o) const { return Key() == o.Key(); }
+    bool operator!=(const EngineOptions& o) const { return !(*this == o); }
+};
 
 struct ASRModel {
-    const SherpaOnnxOnlineRecognizer *recognizer = nullptr;
+    const SherpaOnnxOnlineRecognizer *recognizer = nullptr;          // EngineMode::Transducer
+    const SherpaOnnxKeywordSpotter *keyword_spotter = nullptr;       // EngineMode::KeywordSpotter
     std::string model_path;
+    EngineMode mode = EngineMode::Transducer;
+    EngineOptions options; // As requested (the provider may have fallen back to cpu)
+    std::string variant;   // Files actually loaded: "int8", "fp32" or "int8/fp32", "+opt" for optimized graphs
+    size_t resident_bytes = 0; // Approximate private memory cost (RAM growth during the load, or size on disk)
+    size_t disk_bytes = 0;     // Size of the encoder/decoder/joiner files loaded
+    std::shared_ptr<const TokenPinyinTable> pinyin_table; // Null if the pinyin dictionary is unavailable (transducer only)
+    std::atomic<int> users{0}; // ModelHandles holding it, ModelManager treats the model as idle at 0
     
-    ASRModel(const std::string& path, std::string& error_msg);
+    // words: dirty word list, used for the spotter's default keywords
+    ASRModel(const std::string& path, EngineMode engine_mode, const std::vector<std::string>& words,
+             const EngineOptions& engine_options, std::string& error_msg);
     ~ASRModel();
+    
+    bool IsValid() const { return recognizer || keyword_spotter; }
+    
+    // Stream operations for either engine (streams use the shared SherpaOnnxOnlineStream type).
+    // context: keywords text (KWS) or hotwords text (transducer), empty for a plain stream.
+    const SherpaOnnxOnlineStream *CreateStream(const std::string& context = "") const;
+    // Stream biased towards the dirty words: spotter keywords, or hotwords with hotword_score (0 = no biasing).
+    // skipped: words that could not be expressed in the model's tokens
+    const SherpaOnnxOnlineStream *CreateStreamFor(const std::vector<std::string>& words, float hotword_score, size_t *skipped = nullptr) const;
+    void ResetStream(const SherpaOnnxOnlineStream *stream) const;
+    bool IsReady(const SherpaOnnxOnlineStream *stream) const;
+    void Decode(const SherpaOnnxOnlineStream **streams, int32_t n) const;
+    // Decodes a second of synthetic audio on a throwaway stream, so the first real chunk does not pay
+    // ONNX Runtime's lazy initialization. Returns the time taken in ms.
+    double WarmUp() const;
+    
+    // KWS: dirty words -> keywords text for this model's tokens. Words that cannot be expressed are counted in skipped.
+    std::string BuildKeywords(const std::vector<std::string>& words, size_t *skipped = nullptr) const;
+    // Transducer: dirty words -> hotwords text (one "word :score" per line) for contextual biasing.
+    // Words with characters outside the model's vocabulary are counted in skipped.
+    std::string BuildHotwords(const std::vector<std::string>& words, float score, size_t *skipped = nullptr) const;
+
+private:
+    void LoadTokenSet(const std::string& tokens_path);
+    std::unordered_set<std::string> token_set_;
+    bool has_bpe_ = false; // cjkchar+bpe vocabulary (bilingual models): ASCII words are BPE-encoded by sherpa-onnx
+};
+
+// Outcome of a background load: model is nullptr on failure and error says why
+struct ModelLoad {
+    std::shared_ptr<ASRModel> model;
+    std::string error;
+};
+
+// A filter's use of a model. ModelManager counts these to tell models in use from idle ones, so plain
+// shared_ptr copies (load futures, the preload) never keep a model from expiring.
+class ModelHandle {
+public:
+    ModelHandle() = default;
+    ModelHandle(std::shared_ptr<ASRModel> model) : model_(std::move(model)) { Acquire(); }
+    ModelHandle(const ModelHandle& other) : model_(other.model_) { Acquire(); }
+    ModelHandle& operator=(ModelHandle other) {
+        std::swap(model_, other.model_);
+        return *this;
+    }
+    ~ModelHandle() { reset(); }
+    
+    void reset();
+    ASRModel *get() const { return model_.get(); }
+    ASRModel *operator->() const { return model_.get(); }
+    ASRModel &operator*() const { return *model_; }
+    explicit operator bool() const { return (bool)model_; }
+
+private:
+    void Acquire() {
+        if (model_) model_->users.fetch_add(1);
+    }
+    std::shared_ptr<ASRModel> model_;
 };
 
 class ModelManager {
 public:
-    static std::shared_ptr<ASRModel> Get(const std::string& path, std::string& error_out);
+    // Loads on the calling thread (blocks for the whole ONNX load unless the model is cached)
+    static std::shared_ptr<ASRModel> Get(const std::string& path, EngineMode mode, const std::vector<std::string>& words,
+                                         const EngineOptions& options, std::string& error_out);
+    
+    // Loads on the background loader thread, so ASR workers keep decoding meanwhile.
+    // Ready at once if the model is cached; concurrent requests for the same model share one load.
+    static std::shared_future<ModelLoad> LoadAsync(const std::string& path, EngineMode mode, const std::vector<std::string>& words,
+                                                   const EngineOptions& options);
+    
+    // Joins the loader (module unload), queued loads complete with an error
+    static void Shutdown();
+    
+    // Retention of models no filter uses any more (no ModelHandle): kept for ttl_seconds after their last use
+    // (0 = released at the next check) while all cached models fit in budget_mb, least recently used ones are evicted first
+    static void SetRetention(int ttl_seconds, int budget_mb);
+    
+    struct CacheStats {
+        uint64_t hits = 0;      // Served from memory (in use elsewhere or retained)
+        uint64_t revived = 0;   // Hits on an idle retained model, i.e. reloads the retention saved
+        uint64_t misses = 0;    // Loaded from disk
+        uint64_t evictions = 0;
+        size_t models = 0;      // Retained models, in use or idle
+        size_t idle = 0;
+        double resident_mb = 0.0;
+    };
+    static CacheStats Stats();
+    
+    // ModelHandle: the last handle on model let go, its idle time starts now
+    static void Released(const ASRModel& model);
     
 private:
+    static std::string Key(const std::string& path, EngineMode mode, const EngineOptions& options);
+    static void LoaderLoop();
+    // Requires mutex_. Marks the model as used now (adds it to the retained list)
+    static void Touch(const std::string& key, const std::shared_ptr<ASRModel>& model);
+    // Requires mutex_. Moves expired or over-budget idle models to evicted, destroyed by the caller after unlocking
+    static void Evict(std::vector<std::shared_ptr<ASRModel>>& evicted);
+    static void LogStats(const char *event, const std::string& path); // Requires mutex_
+    
     static std::map<std::string, std::weak_ptr<ASRModel>> models_;
     static std::mutex mutex_;
+    
+    struct Retained {
+        std::string key;
+        std::shared_ptr<ASRModel> model;
+        std::chrono::steady_clock::time_point last_used; // Last lookup or last handle released
+    };
+    static std::list<Retained> retained_; // Most recently used first
+    static std::chrono::seconds retention_ttl_;
+    static size_t retention_budget_bytes_;
+    static CacheStats stats_;
+    
+    struct LoadRequest {
+        std::string key;
+        std::string path;
+        EngineMode mode;
+        std::vector<std::string> words;
+        EngineOptions options;
+        std::promise<ModelLoad> promise;
+    };
+    static std::mutex loader_mutex_;
+    static std::condition_variable loader_cv_;
+    static std::deque<LoadRequest> load_queue_;
+    static std::map<std::string, std::shared_future<ModelLoad>> loads_in_flight_;
+    static std::thread loader_;
+    static bool loader_stop_;
 };
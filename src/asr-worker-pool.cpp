@@ -0,0 +1,205 @@
+#include "asr-worker-pool.hpp"
+#include "profanity-filter.hpp"
+#include "asr-model.hpp"
+#include "auto-tuner.hpp"
+#include "logging-macros.hpp"
+
+#include <obs-module.h>
+
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+// Upper bound on how long an idle worker sleeps; covers notifies lost to the lock-free Notify()
+static constexpr auto kIdlePoll = chrono::milliseconds(20);
+// Decode statistics are logged once per this much decoded audio
+static constexpr double kStatsPeriodSeconds = 300.0;
+
+ASRWorkerPool &ASRWorkerPool::Instance() {
+    static ASRWorkerPool instance;
+    return instance;
+}
+
+ASRWorkerPool::~ASRWorkerPool() {
+    Shutdown();
+}
+
+void ASRWorkerPool::Register(ProfanityFilter *filter) {
+    lock_guard<mutex> lock(mutex_);
+    slots_.push_back({filter, false, chrono::steady_clock::now()});
+    if (workers_.empty() && !stop_ && !shutdown_) StartWorkers();
+    work_cv_.notify_all();
+}
+
+void ASRWorkerPool::Unregister(ProfanityFilter *filter) {
+    unique_lock<mutex> lock(mutex_);
+    auto find_slot = [&] {
+        return find_if(slots_.begin(), slots_.end(), [&](const Slot &s) { return s.filter == filter; });
+    };
+    if (find_slot() == slots_.end()) return;
+    idle_cv_.wait(lock, [&] { return !find_slot()->busy; });
+    slots_.erase(find_slot());
+}
+
+void ASRWorkerPool::Notify() {
+    work_cv_.notify_one();
+}
+
+void ASRWorkerPool::SetThreadCount(int count) {
+    count = clamp(count, 1, 8);
+    unique_lock<mutex> lock(mutex_);
+    if (count == thread_count_) return;
+    thread_count_ = count;
+    if (workers_.empty()) return; // Applied on first Register
+
+    StopWorkers(lock);
+    if (!slots_.empty() && !shutdown_) StartWorkers();
+    BLOG(LOG_INFO, "ASR worker pool resized to %d threads", count);
+}
+
+void ASRWorkerPool::Shutdown() {
+    unique_lock<mutex> lock(mutex_);
+    shutdown_ = true;
+    StopWorkers(lock);
+}
+
+void ASRWorkerPool::StartWorkers() {
+    for (int i = 0; i < thread_count_; i++) {
+        workers_.emplace_back(&ASRWorkerPool::WorkerLoop, this);
+    }
+}
+
+void ASRWorkerPool::StopWorkers(unique_lock<mutex> &lock) {
+    stop_ = true;
+    work_cv_.notify_all();
+    vector<thread> workers = std::move(workers_);
+    workers_.clear();
+    lock.unlock();
+    for (auto &t : workers) {
+        if (t.joinable()) t.join();
+    }
+    lock.lock();
+    stop_ = false;
+}
+
+void ASRWorkerPool::WorkerLoop() {
+    vector<ProfanityFilter*> batch;
+    vector<pair<double, size_t>> due; // (slack ms, slot index)
+
+    unique_lock<mutex> lock(mutex_);
+    while (!stop_) {
+        if (slots_.empty()) {
+            work_cv_.wait(lock);
+            continue;
+        }
+
+        // Claim due filters earliest deadline first: the source whose oldest queued audio plays out soonest.
+        // A starved source's slack keeps shrinking, so EDF cannot starve it. The cap spreads many sources
+        // over the workers while streams on one recognizer still decode together.
+        size_t max_batch = (slots_.size() + thread_count_ - 1) / thread_count_;
+        auto now = chrono::steady_clock::now();
+        due.clear();
+        for (size_t k = 0; k < slots_.size(); k++) {
+            const Slot &slot = slots_[k];
+            if (slot.busy || !slot.filter->AsrDue(now - slot.last_service)) continue;
+            due.push_back({slot.filter->AsrSlackMs(), k});
+        }
+        if (due.size() > max_batch) {
+            partial_sort(due.begin(), due.begin() + max_batch, due.end());
+            due.resize(max_batch);
+        }
+        batch.clear();
+        for (const auto &d : due) {
+            Slot &slot = slots_[d.second];
+            slot.busy = true;
+            slot.last_service = now;
+            batch.push_back(slot.filter);
+        }
+
+        if (batch.empty()) {
+            work_cv_.wait_for(lock, kIdlePoll);
+            continue;
+        }
+
+        lock.unlock();
+        RunBatch(batch);
+        lock.lock();
+
+        for (auto &slot : slots_) {
+            if (find(batch.begin(), batch.end(), slot.filter) != batch.end()) slot.busy = false;
+        }
+        idle_cv_.notify_all();
+    }
+}
+
+void ASRWorkerPool::RunBatch(const vector<ProfanityFilter*> &batch) {
+    vector<ProfanityFilter*> fed;
+    for (auto *filter : batch) {
+        if (filter->AsrFeed()) fed.push_back(filter);
+    }
+    if (fed.empty()) {
+        for (auto *filter : batch) filter->AsrRunEscalations();
+        return;
+    }
+
+    // Filters on the same model share one recognizer or spotter (ModelManager), decode those streams together
+    auto model_of = [](const ProfanityFilter *f) { return f->asr_model.get(); };
+    sort(fed.begin(), fed.end(), [&](const ProfanityFilter *a, const ProfanityFilter *b) {
+        return less<const ASRModel*>()(model_of(a), model_of(b));
+    });
+
+    vector<const SherpaOnnxOnlineStream*> ready;
+    for (size_t group = 0; group < fed.size();) {
+        const ASRModel *model = model_of(fed[group]);
+        size_t group_end = group;
+        size_t audio_samples = 0;
+        while (group_end < fed.size() && model_of(fed[group_end]) == model) {
+            audio_samples += fed[group_end]->asr_chunk.size();
+            group_end++;
+        }
+
+        auto decode_start = chrono::steady_clock::now();
+        while (true) {
+            ready.clear();
+            for (size_t i = group; i < group_end; i++) {
+                if (model->IsReady(fed[i]->stream)) ready.push_back(fed[i]->stream);
+            }
+            if (ready.empty()) break;
+            model->Decode(ready.data(), (int32_t)ready.size());
+        }
+        RecordDecode(*model, chrono::steady_clock::now() - decode_start, audio_samples);
+        group = group_end;
+    }
+
+    for (auto *filter : fed) {
+        filter->AsrHandleResult();
+    }
+    // Cascade windows complete once enough audio follows them, which also happens while VAD skips
+    for (auto *filter : batch) {
+        filter->AsrRunEscalations();
+    }
+}
+
+void ASRWorkerPool::RecordDecode(const ASRModel &model, chrono::steady_clock::duration decode_time, size_t audio_samples) {
+    if (model.mode == EngineMode::Transducer) {
+        AutoTuner::Instance().Report(chrono::duration<double>(decode_time).count(), audio_samples / 16000.0);
+    }
+
+    // One line per engine configuration, so e.g. int8 and fp32 runs of the same model can be compared
+    char label[128];
+    snprintf(label, sizeof(label), "%s, %s, %d threads%s%s", model.mode == EngineMode::KeywordSpotter ? "KWS" : "transducer",
+        model.variant.c_str(), model.options.num_threads, model.recognizer ? ", " : "",
+        model.recognizer ? model.options.decoding_method.c_str() : "");
+
+    lock_guard<mutex> lock(stats_mutex_);
+    DecodeStats &stats = decode_stats_[label];
+    stats.decode_seconds += chrono::duration<double>(decode_time).count();
+    stats.audio_seconds += audio_samples / 16000.0;
+    if (stats.audio_seconds < kStatsPeriodSeconds) return;
+
+    // Real-time factor over the period (decode time / audio time, summed over all streams on this engine)
+    BLOG(LOG_INFO, "ASR decode RTF (%s): %.3f over %.0f s of audio", label,
+        stats.decode_seconds / stats.audio_seconds, stats.audio_seconds);
+    stats = DecodeStats();
+}
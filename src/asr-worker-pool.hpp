@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <map>
+#include <string>
+
+class ProfanityFilter;
+struct ASRModel;
+
+// Fixed-size pool that runs ASR for every ProfanityFilter instance.
+// A worker claims a batch of due filters (earliest playout deadline first), feeds their audio, then decodes
+// all ready streams that share a model (recognizer or keyword spotter) with one batched decode call.
+// A filter is only ever serviced by one worker at a time, so its stream and matching state need no extra locking.
+class ASRWorkerPool {
+public:
+    static ASRWorkerPool &Instance();
+
+    void Register(ProfanityFilter *filter);
+    // Blocks until no worker is servicing the filter. Must not be called from a worker.
+    void Unregister(ProfanityFilter *filter);
+
+    // Called from the audio thread when a filter has a full chunk queued. Does not lock.
+    void Notify();
+
+    // Restarts the workers if the count changes (takes effect immediately)
+    void SetThreadCount(int count);
+
+    // Joins the workers (module unload)
+    void Shutdown();
+
+private:
+    ASRWorkerPool() = default;
+    ~ASRWorkerPool();
+
+    struct Slot {
+        ProfanityFilter *filter;
+        bool busy = false;
+        std::chrono::steady_clock::time_point last_service;
+    };
+
+    void StartWorkers();   // Requires mutex_
+    void StopWorkers(std::unique_lock<std::mutex> &lock);
+    void WorkerLoop();
+    void RunBatch(const std::vector<ProfanityFilter*> &batch);
+    void RecordDecode(const ASRModel &model, std::chrono::steady_clock::duration decode_time, size_t audio_samples);
+
+    struct DecodeStats {
+        double decode_seconds = 0.0;
+        double audio_seconds = 0.0;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable idle_cv_;   // Signalled when a batch is released (Unregister waits on it)
+    std::vector<Slot> slots_;
+    std::vector<std::thread> workers_;
+    int thread_count_ = 2;
+    bool stop_ = false;
+    bool shutdown_ = false;
+
+    std::mutex stats_mutex_;
+    std::map<std::string, DecodeStats> decode_stats_; // Per engine configuration
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+// Last few seconds of the 16 kHz model input, addressed by absolute sample index.
+// Only touched by the worker servicing the owning filter, so it needs no locking.
+class AudioHistory {
+public:
+    explicit AudioHistory(size_t capacity) : buffer_(capacity, 0.0f) {}
+
+    // Appends model input; the last sample has absolute 16k index end_index - 1
+    void Append(const float *samples, size_t n, uint64_t end_index) {
+        size_t cap = buffer_.size();
+        if (n > cap) {
+            samples += n - cap;
+            n = cap;
+        }
+        uint64_t start = end_index - n;
+        for (size_t i = 0; i < n; i++) {
+            buffer_[(start + i) % cap] = samples[i];
+        }
+        end_ = end_index;
+    }
+
+    // Oldest absolute index still held
+    uint64_t Oldest() const { return (end_ > buffer_.size()) ? end_ - buffer_.size() : 0; }
+    uint64_t End() const { return end_; }
+
+    // True if [start, end) is still fully in the history
+    bool Holds(uint64_t start, uint64_t end) const {
+        return start < end && end <= end_ && start >= Oldest();
+    }
+
+    // Copies [start, end) into out (resized), requires Holds(start, end)
+    void Read(uint64_t start, uint64_t end, std::vector<float> &out) const {
+        size_t cap = buffer_.size();
+        out.resize((size_t)(end - start));
+        for (size_t i = 0; i < out.size(); i++) {
+            out[i] = buffer_[(start + i) % cap];
+        }
+    }
+
+private:
+    std::vector<float> buffer_; // Circular, index % capacity
+    uint64_t end_ = 0;          // Absolute index just past the newest sample
+};
@@ -0,0 +1,63 @@
+#include "auto-tuner.hpp"
+#include "logging-macros.hpp"
+
+#include <obs-module.h>
+
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+
+struct TuneStep {
+    int threads;
+    bool greedy;
+};
+
+// Each step roughly halves the decode time of the previous one
+static const TuneStep kLadder[] = {{1, false}, {2, false}, {2, true}, {4, true}};
+static constexpr int kSteps = (int)(sizeof(kLadder) / sizeof(kLadder[0]));
+
+// Decisions are made over this much decoded audio
+static constexpr double kWindowSeconds = 30.0;
+// Step up above kSlowRtf (little headroom left for more sources or a busy encoder),
+// step down below kFastRtf (the previous step would still be well under kSlowRtf)
+static constexpr double kSlowRtf = 0.6;
+static constexpr double kFastRtf = 0.15;
+
+AutoTuner &AutoTuner::Instance() {
+    static AutoTuner instance;
+    return instance;
+}
+
+void AutoTuner::Report(double decode_seconds, double audio_seconds) {
+    lock_guard<mutex> lock(mutex_);
+    decode_seconds_ += decode_seconds;
+    audio_seconds_ += audio_seconds;
+    if (audio_seconds_ < kWindowSeconds) return;
+
+    double rtf = decode_seconds_ / audio_seconds_;
+    decode_seconds_ = 0.0;
+    audio_seconds_ = 0.0;
+
+    int step = step_.load();
+    int next = step;
+    if (rtf > kSlowRtf && step + 1 < kSteps) next = step + 1;
+    else if (rtf < kFastRtf && step > 0) next = step - 1;
+    if (next == step) return;
+
+    step_.store(next);
+    BLOG(LOG_INFO, "Auto tuning: RTF %.2f, switching to %d threads / %s", rtf, kLadder[next].threads,
+         kLadder[next].greedy ? "greedy_search" : "modified_beam_search");
+}
+
+void AutoTuner::Apply(EngineOptions &options, bool auto_threads, bool auto_decoding) const {
+    const TuneStep &step = kLadder[step_.load()];
+    if (auto_threads) {
+        // Leave at least half the cores to OBS and the encoder
+        int max_threads = max(1, (int)thread::hardware_concurrency() / 2);
+        options.num_threads = min(step.threads, max_threads);
+    }
+    if (auto_decoding) {
+        options.decoding_method = step.greedy ? "greedy_search" : "modified_beam_search";
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include "asr-model.hpp"
+
+// Settings for the recognizer options left on "auto".
+// Walks a ladder from the most accurate to the fastest setting (more threads first, then greedy search)
+// based on the decode real-time factor the worker pool measures, with hysteresis so it settles.
+class AutoTuner {
+public:
+    static AutoTuner &Instance();
+
+    // Transducer decode time spent on audio_seconds of audio (summed over the streams of one batch)
+    void Report(double decode_seconds, double audio_seconds);
+
+    // Fills the fields the user left on auto from the current step
+    void Apply(EngineOptions &options, bool auto_threads, bool auto_decoding) const;
+
+private:
+    AutoTuner() = default;
+
+    std::atomic<int> step_{0};
+    std::mutex mutex_;
+    double decode_seconds_ = 0.0;
+    double audio_seconds_ = 0.0;
+};
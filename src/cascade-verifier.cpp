@@ -0,0 +1,25 @@
+#include "cascade-verifier.hpp"
+#include "asr-model.hpp"
+
+using namespace std;
+
+// Zero padding after the window so the streaming encoder flushes its right context
+static constexpr size_t kTailPadding = 16000 * 3 / 10;
+
+const SherpaOnnxOnlineRecognizerResult *CascadeVerifier::Decode(const ASRModel &model, const AudioHistory &history, uint64_t start, uint64_t end) {
+    if (!model.recognizer || !history.Holds(start, end)) return nullptr;
+
+    history.Read(start, end, window_);
+    window_.resize(window_.size() + kTailPadding, 0.0f);
+
+    const SherpaOnnxOnlineStream *stream = model.CreateStream();
+    if (!stream) return nullptr;
+    SherpaOnnxOnlineStreamAcceptWaveform(stream, 16000, window_.data(), (int32_t)window_.size());
+    SherpaOnnxOnlineStreamInputFinished(stream);
+    while (model.IsReady(stream)) {
+        model.Decode(&stream, 1);
+    }
+    const SherpaOnnxOnlineRecognizerResult *result = SherpaOnnxGetOnlineStreamResult(model.recognizer, stream);
+    SherpaOnnxDestroyOnlineStream(stream);
+    return result;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "sherpa-onnx/c-api/c-api.h"
+#include "audio-history.hpp"
+
+class ASRModel;
+
+// Second tier of the model cascade.
+// Re-decodes a window of the 16 kHz audio given to the first tier (kept in the filter's AudioHistory) with the
+// large model on demand. The window is decoded in one go (fed, padded, input finished), so only escalated
+// windows pay the large model's cost.
+class CascadeVerifier {
+public:
+    // Decodes [start, end) of history on a fresh stream, timestamps in the result are relative to start.
+    // nullptr on failure; otherwise free with SherpaOnnxDestroyOnlineRecognizerResult.
+    const SherpaOnnxOnlineRecognizerResult *Decode(const ASRModel &model, const AudioHistory &history, uint64_t start, uint64_t end);
+
+private:
+    std::vector<float> window_;  // Reused per Decode
+};
@@ -0,0 +1,176 @@
+#include "censor-effects.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+// Samples rendered per pass, wet signal and gains live on the stack
+static constexpr size_t kChunk = 256;
+
+// One sine cycle, 2^kTableBits entries plus a guard for the interpolation
+static constexpr int kTableBits = 12;
+static constexpr size_t kTableSize = (size_t)1 << kTableBits;
+
+static const float *SineTable() {
+    static const vector<float> table = [] {
+        vector<float> t(kTableSize + 1);
+        for (size_t i = 0; i <= kTableSize; i++) {
+            t[i] = (float)sin(2.0 * 3.14159265358979323846 * (double)i / (double)kTableSize);
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+// Linear interpolated sine of a 32-bit phase (2^32 = one cycle)
+static inline float SineAt(const float *table, uint32_t phase) {
+    uint32_t index = phase >> (32 - kTableBits);
+    float frac = (float)(phase & ((1u << (32 - kTableBits)) - 1)) * (1.0f / (float)(1u << (32 - kTableBits)));
+    return table[index] + frac * (table[index + 1] - table[index]);
+}
+
+// Phase accumulator of a freq Hz oscillator, started at the phase it has at absolute sample position
+struct Oscillator {
+    uint32_t phase;
+    uint32_t increment;
+
+    Oscillator(uint32_t freq, uint32_t sr, uint64_t position) {
+        phase = (uint32_t)((double)((position * freq) % sr) * 4294967296.0 / (double)sr);
+        increment = (uint32_t)((double)freq * 4294967296.0 / (double)sr);
+    }
+};
+
+struct GeneratorContext {
+    uint32_t sample_rate;
+    uint32_t beep_frequency;
+    const float *table;
+};
+
+// Generators fill wet[0, n) for absolute positions [position, position + n).
+// kForceWet: replaces the audio fully regardless of the mix setting.
+
+struct SilenceGenerator {
+    static constexpr bool kForceWet = false;
+    static void Generate(const GeneratorContext &, const float *, size_t n, uint64_t, float *wet) {
+        fill(wet, wet + n, 0.0f);
+    }
+};
+
+struct BeepGenerator {
+    static constexpr bool kForceWet = false;
+    static void Generate(const GeneratorContext &ctx, const float *, size_t n, uint64_t position, float *wet) {
+        Oscillator osc(ctx.beep_frequency, ctx.sample_rate, position);
+        for (size_t i = 0; i < n; i++) {
+            wet[i] = 0.1f * SineAt(ctx.table, osc.phase + (uint32_t)i * osc.increment);
+        }
+    }
+};
+
+// Barberpole pitch shifter, one octave up (Minion voice): two taps sweep the lookback window
+// with triangle gains, half a window apart. Reads the pristine input, so there is no feedback.
+struct PitchShiftGenerator {
+    static constexpr bool kForceWet = true;
+    static constexpr uint64_t kWindow = CensorRenderer::kLookback; // Power of two
+    static void Generate(const GeneratorContext &, const float *dry, size_t n, uint64_t position, float *wet) {
+        const float scale = 1.0f / (float)kWindow;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t m_a = (position + i) & (kWindow - 1);          // Window phase of tap A in samples
+            uint64_t m_b = (m_a + kWindow / 2) & (kWindow - 1);     // Tap B, half a window later
+            float gain_a = 1.0f - 2.0f * fabsf((float)m_a * scale - 0.5f);
+            float gain_b = 1.0f - 2.0f * fabsf((float)m_b * scale - 0.5f);
+            // Tap delay shrinks from kWindow to 1 over the window
+            wet[i] = dry[(ptrdiff_t)i - (ptrdiff_t)(kWindow - m_a)] * gain_a +
+                     dry[(ptrdiff_t)i - (ptrdiff_t)(kWindow - m_b)] * gain_b;
+        }
+    }
+};
+
+// Telegraph (Morse code style): 750 Hz carrier keyed on and off by two slow sines (8 Hz dits, 3 Hz word rhythm)
+struct TelegraphGenerator {
+    static constexpr bool kForceWet = true;
+    static void Generate(const GeneratorContext &ctx, const float *, size_t n, uint64_t position, float *wet) {
+        Oscillator carrier(750, ctx.sample_rate, position);
+        Oscillator dits(8, ctx.sample_rate, position);
+        Oscillator words(3, ctx.sample_rate, position);
+        for (size_t i = 0; i < n; i++) {
+            float rhythm = SineAt(ctx.table, dits.phase + (uint32_t)i * dits.increment) +
+                           SineAt(ctx.table, words.phase + (uint32_t)i * words.increment);
+            float envelope = (rhythm > 0.0f) ? 1.0f : 0.0f;
+            wet[i] = 0.15f * SineAt(ctx.table, carrier.phase + (uint32_t)i * carrier.increment) * envelope;
+        }
+    }
+};
+
+CensorRenderer::CensorRenderer() {
+    SineTable(); // Built here, not on the audio thread
+}
+
+void CensorRenderer::Configure(uint32_t sample_rate, int effect, int beep_frequency, int mix_percent) {
+    sample_rate_ = sample_rate ? sample_rate : 48000;
+    effect_ = effect;
+    beep_frequency_ = (uint32_t)clamp(beep_frequency, 1, (int)sample_rate_ / 2);
+    mix_ = (float)clamp(mix_percent, 0, 100) / 100.0f;
+    ramp_ = max<size_t>(1, (size_t)(kRampSeconds * sample_rate_));
+}
+
+void CensorRenderer::Render(float *out, const float *dry, size_t n, uint64_t position, uint64_t start, uint64_t end) const {
+    switch (effect_) {
+    case Silence: RenderWith<SilenceGenerator>(out, dry, n, position, start, end); break;
+    case PitchShift: RenderWith<PitchShiftGenerator>(out, dry, n, position, start, end); break;
+    case Telegraph: RenderWith<TelegraphGenerator>(out, dry, n, position, start, end); break;
+    default: RenderWith<BeepGenerator>(out, dry, n, position, start, end); break;
+    }
+}
+
+// out[i] = dry[i] + gain * (wet[i] - dry[i]), gain ramping up over [start - ramp, start),
+// 1 inside the region and ramping down over [end, end + ramp). out may alias dry.
+static void Crossfade(float *out, const float *dry, const float *wet, size_t n, uint64_t position,
+                      uint64_t start, uint64_t end, size_t ramp, float mix) {
+    float ramp_step = 1.0f / (float)ramp;
+    float fade_in = ((float)((int64_t)position - (int64_t)start) + (float)ramp) * ramp_step;
+    float fade_out = ((float)((int64_t)end - (int64_t)position) + (float)ramp) * ramp_step;
+    for (size_t i = 0; i < n; i++) {
+        float offset = (float)i * ramp_step;
+        float gain = min(1.0f, min(fade_in + offset, fade_out - offset));
+        gain = max(0.0f, gain) * mix;
+        out[i] = dry[i] + gain * (wet[i] - dry[i]);
+    }
+}
+
+float CensorRenderer::WetMix() const {
+    switch (effect_) {
+    case Silence: return SilenceGenerator::kForceWet ? 1.0f : mix_;
+    case PitchShift: return PitchShiftGenerator::kForceWet ? 1.0f : mix_;
+    case Telegraph: return TelegraphGenerator::kForceWet ? 1.0f : mix_;
+    default: return BeepGenerator::kForceWet ? 1.0f : mix_;
+    }
+}
+
+void CensorRenderer::RenderWet(float *wet, size_t n, uint64_t position) const {
+    GeneratorContext ctx{sample_rate_, beep_frequency_, SineTable()};
+    switch (effect_) {
+    case Silence: SilenceGenerator::Generate(ctx, nullptr, n, position, wet); break;
+    case Telegraph: TelegraphGenerator::Generate(ctx, nullptr, n, position, wet); break;
+    case PitchShift: fill(wet, wet + n, 0.0f); break; // Needs the input, rendered in Render instead
+    default: BeepGenerator::Generate(ctx, nullptr, n, position, wet); break;
+    }
+}
+
+void CensorRenderer::Mix(float *out, const float *wet, size_t n, uint64_t position, uint64_t start, uint64_t end) const {
+    Crossfade(out, out, wet, n, position, start, end, ramp_, WetMix());
+}
+
+template <class Generator>
+void CensorRenderer::RenderWith(float *out, const float *dry, size_t n, uint64_t position, uint64_t start, uint64_t end) const {
+    GeneratorContext ctx{sample_rate_, beep_frequency_, SineTable()};
+    float mix = Generator::kForceWet ? 1.0f : mix_;
+
+    float wet[kChunk];
+    for (size_t done = 0; done < n; done += kChunk) {
+        size_t count = min(kChunk, n - done);
+        Generator::Generate(ctx, dry + done, count, position + done, wet);
+        Crossfade(out + done, dry + done, wet, count, position + done, start, end, ramp_, mix);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Block renderer for the censor effects (beep, silence, pitch shift, telegraph).
+// Each effect is a small generator class specialized at compile time, so a region is rendered by one
+// branch-free pass per effect plus one mixing pass. Oscillators run on phase accumulators over a shared
+// sine table, with their phase derived from the absolute input position, so blocks and channels line up.
+// Regions fade in and out over kRampSeconds outside [start, end), the censored span itself is fully covered.
+class CensorRenderer {
+public:
+    enum Effect { Beep = 0, Silence = 1, PitchShift = 2, Telegraph = 3 };
+
+    static constexpr size_t kLookback = 2048;      // Longest input lookback of an effect (pitch shifter window)
+    static constexpr double kRampSeconds = 0.005;  // Edge fade length
+
+    CensorRenderer();
+
+    // Cheap, call once per audio callback
+    void Configure(uint32_t sample_rate, int effect, int beep_frequency, int mix_percent);
+
+    size_t RampSamples() const { return ramp_; }
+
+    // True if the effect does not depend on the input, so its replacement audio can be rendered ahead of time
+    bool Precomputable() const { return effect_ != PitchShift; }
+
+    // Identifies what RenderWet produces (effect, frequency, rate), to tell whether a pre-rendered segment is stale
+    uint64_t Signature() const { return ((uint64_t)sample_rate_ << 32) | ((uint64_t)beep_frequency_ << 8) | (uint64_t)effect_; }
+
+    // Censors out[0, n), the samples at absolute input positions [position, position + n), for the region
+    // [start, end). out holds the pristine samples on entry; dry points at the same pristine samples and
+    // must also be readable kLookback samples before dry[0].
+    void Render(float *out, const float *dry, size_t n, uint64_t position, uint64_t start, uint64_t end) const;
+
+    // Replacement audio only, for [position, position + n). Requires Precomputable().
+    void RenderWet(float *wet, size_t n, uint64_t position) const;
+
+    // Crossfades pre-rendered replacement audio into out[0, n) (pristine on entry) with the region's edge fades
+    void Mix(float *out, const float *wet, size_t n, uint64_t position, uint64_t start, uint64_t end) const;
+
+private:
+    template <class Generator>
+    void RenderWith(float *out, const float *dry, size_t n, uint64_t position, uint64_t start, uint64_t end) const;
+    float WetMix() const;
+
+    uint32_t sample_rate_ = 48000;
+    int effect_ = Beep;
+    uint32_t beep_frequency_ = 1000;
+    float mix_ = 1.0f;
+    size_t ramp_ = 240;
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+
+// Multi-channel audio delay line, addressed by absolute input sample index.
+// Capacity is a power of two so a position maps to its slot with a mask instead of a modulo.
+// Not thread-safe: allocated off the audio thread, then handed over and only used by it.
+class DelayLine {
+public:
+    static constexpr size_t kMaxChannels = 8; // MAX_AV_PLANES
+
+    // Smallest power of two >= n
+    static size_t RoundUp(size_t n) {
+        size_t capacity = 1;
+        while (capacity < n) capacity <<= 1;
+        return capacity;
+    }
+
+    // Drops all history; capacity is rounded up to a power of two
+    void Allocate(size_t channels, size_t min_capacity) {
+        size_t capacity = RoundUp(std::max<size_t>(min_capacity, 1));
+        buffers_.assign(channels, std::vector<float>(capacity, 0.0f));
+        mask_ = capacity - 1;
+        end_ = 0;
+        handover_ = 0;
+    }
+
+    void Release() {
+        std::vector<std::vector<float>>().swap(buffers_);
+        mask_ = 0;
+        end_ = 0;
+        handover_ = 0;
+    }
+
+    size_t Channels() const { return buffers_.size(); }
+    size_t Capacity() const { return buffers_.empty() ? 0 : mask_ + 1; }
+    size_t Bytes() const { return Channels() * Capacity() * sizeof(float); }
+
+    // Absolute index just past the newest sample, and the oldest one still held
+    uint64_t End() const { return end_; }
+    uint64_t Oldest() const { return (end_ > Capacity()) ? end_ - Capacity() : 0; }
+
+    // Appends frames to every channel, planes[c] may be null (written as silence).
+    // At most two contiguous copies per channel (the write wraps once at most).
+    void Write(const float *const *planes, size_t channels, size_t frames) {
+        if (frames > Capacity()) {
+            // Only the newest Capacity() samples survive
+            size_t skip = frames - Capacity();
+            const float *shifted[kMaxChannels] = {};
+            for (size_t c = 0; c < std::min(channels, kMaxChannels); c++) {
+                shifted[c] = planes[c] ? planes[c] + skip : nullptr;
+            }
+            end_ += skip;
+            Write(shifted, std::min(channels, kMaxChannels), frames - skip);
+            return;
+        }
+        size_t slot = (size_t)(end_ & mask_);
+        size_t first = std::min(frames, Capacity() - slot);
+        for (size_t c = 0; c < Channels(); c++) {
+            const float *in = (c < channels) ? planes[c] : nullptr;
+            float *ring = buffers_[c].data();
+            if (in) {
+                memcpy(ring + slot, in, first * sizeof(float));
+                memcpy(ring, in + first, (frames - first) * sizeof(float));
+            } else {
+                memset(ring + slot, 0, first * sizeof(float));
+                memset(ring, 0, (frames - first) * sizeof(float));
+            }
+        }
+        end_ += frames;
+    }
+
+    // Copies [start, start + n) of a channel into out, silence where it is not held.
+    // At most two contiguous copies for the part inside the ring.
+    void Read(size_t channel, int64_t start, size_t n, float *out) const {
+        int64_t held_start = std::max(start, (int64_t)Oldest());
+        int64_t held_end = std::min(start + (int64_t)n, (int64_t)end_);
+        if (held_start >= held_end) {
+            memset(out, 0, n * sizeof(float));
+            return;
+        }
+        size_t before = (size_t)(held_start - start);
+        size_t count = (size_t)(held_end - held_start);
+        memset(out, 0, before * sizeof(float));
+        memset(out + before + count, 0, (n - before - count) * sizeof(float));
+
+        const float *ring = buffers_[channel].data();
+        size_t slot = (size_t)((uint64_t)held_start & mask_);
+        size_t first = std::min(count, Capacity() - slot);
+        memcpy(out + before, ring + slot, first * sizeof(float));
+        memcpy(out + before + first, ring, (count - first) * sizeof(float));
+    }
+
+    // Sample at absolute position p, silence if it is not held
+    float At(size_t channel, int64_t p) const {
+        if (p < (int64_t)Oldest() || p >= (int64_t)end_) return 0.0f;
+        return buffers_[channel][(uint64_t)p & mask_];
+    }
+
+    // Handover from a line in use without one long copy: BeginHandover continues at other's position,
+    // every later Write goes to both lines, and ContinueHandover copies the history over in slices.
+    void BeginHandover(const DelayLine &other) {
+        end_ = other.end_;
+        handover_ = end_;
+    }
+
+    // Copies up to max_frames more history per channel from other, newest first (at most two contiguous
+    // copies per channel). True once every sample both lines hold is in place.
+    bool ContinueHandover(const DelayLine &other, size_t max_frames) {
+        uint64_t floor = std::max(Oldest(), other.Oldest());
+        if (handover_ <= floor) return true;
+        size_t count = (size_t)std::min<uint64_t>(max_frames, handover_ - floor);
+        uint64_t start = handover_ - count;
+        size_t slot = (size_t)(start & mask_);
+        size_t first = std::min(count, Capacity() - slot);
+        for (size_t c = 0; c < Channels(); c++) {
+            float *ring = buffers_[c].data();
+            if (c < other.Channels()) {
+                other.Read(c, (int64_t)start, first, ring + slot);
+                other.Read(c, (int64_t)(start + first), count - first, ring);
+            } else {
+                memset(ring + slot, 0, first * sizeof(float));
+                memset(ring, 0, (count - first) * sizeof(float));
+            }
+        }
+        handover_ = start;
+        return handover_ <= floor;
+    }
+
+    void Swap(DelayLine &other) {
+        buffers_.swap(other.buffers_);
+        std::swap(mask_, other.mask_);
+        std::swap(end_, other.end_);
+        std::swap(handover_, other.handover_);
+    }
+
+private:
+    std::vector<std::vector<float>> buffers_; // One ring per channel, slot = position & mask_
+    size_t mask_ = 0;
+    uint64_t end_ = 0;
+    uint64_t handover_ = 0; // History below this is still to be copied by ContinueHandover
+};
@@ -0,0 +1,195 @@
+#include "graph-optimizer.hpp"
+#include "logging-macros.hpp"
+
+#include <obs-module.h>
+#include <windows.h>
+#include <onnxruntime_c_api.h>
+
+#include <filesystem>
+#include <chrono>
+#include <algorithm>
+
+using namespace std;
+
+static constexpr const char *kOptimizedSuffix = ".optimized";
+
+// An optimized graph this much larger than the original (e.g. folded int8 weights) is not worth loading
+static constexpr double kMaxGrowth = 1.5;
+
+static wstring Widen(const string &utf8) {
+    int n = MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), (int)utf8.size(), nullptr, 0);
+    wstring out(n, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), (int)utf8.size(), out.data(), n);
+    return out;
+}
+
+static filesystem::path ToPath(const string &utf8) {
+    return filesystem::path(Widen(utf8));
+}
+
+// The onnxruntime.dll sherpa-onnx was loaded with, nullptr if it is missing or older than our header
+static const OrtApi *GetOrtApi() {
+    HMODULE module = GetModuleHandleW(L"onnxruntime.dll");
+    if (!module) return nullptr;
+    using GetApiBaseFn = const OrtApiBase *(ORT_API_CALL *)(void);
+    auto get_api_base = (GetApiBaseFn)GetProcAddress(module, "OrtGetApiBase");
+    if (!get_api_base) return nullptr;
+    return get_api_base()->GetApi(ORT_API_VERSION);
+}
+
+// Releases the status, true if it was a success
+static bool Check(const OrtApi *api, OrtStatus *status, const char *what) {
+    if (!status) return true;
+    BLOG(LOG_WARNING, "Graph optimization: %s failed: %s", what, api->GetErrorMessage(status));
+    api->ReleaseStatus(status);
+    return false;
+}
+
+// Creates and releases a session, ms taken or a negative value on failure.
+// save_to: writes the graph after ORT_ENABLE_EXTENDED (portable across machines, unlike ORT_ENABLE_ALL)
+static double TimeSession(const OrtApi *api, OrtEnv *env, const string &model, const string &save_to = "") {
+    OrtSessionOptions *options = nullptr;
+    if (!Check(api, api->CreateSessionOptions(&options), "CreateSessionOptions")) return -1.0;
+    bool ok = Check(api, api->SetIntraOpNumThreads(options, 1), "SetIntraOpNumThreads");
+    wstring save_path = Widen(save_to);
+    if (ok && !save_to.empty()) {
+        ok = Check(api, api->SetSessionGraphOptimizationLevel(options, ORT_ENABLE_EXTENDED), "SetSessionGraphOptimizationLevel") &&
+             Check(api, api->SetOptimizedModelFilePath(options, save_path.c_str()), "SetOptimizedModelFilePath");
+    }
+
+    double ms = -1.0;
+    if (ok) {
+        wstring model_path = Widen(model);
+        OrtSession *session = nullptr;
+        auto start = chrono::steady_clock::now();
+        if (Check(api, api->CreateSession(env, model_path.c_str(), options, &session), "CreateSession")) {
+            ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            api->ReleaseSession(session);
+        }
+    }
+    api->ReleaseSessionOptions(options);
+    return ms;
+}
+
+static bool IsTransducerFile(const string &name) {
+    bool onnx = name.size() > 5 && name.compare(name.size() - 5, 5, ".onnx") == 0;
+    return onnx && (name.rfind("encoder", 0) == 0 || name.rfind("decoder", 0) == 0 || name.rfind("joiner", 0) == 0);
+}
+
+GraphOptimizer &GraphOptimizer::Instance() {
+    static GraphOptimizer instance;
+    return instance;
+}
+
+GraphOptimizer::~GraphOptimizer() {
+    Shutdown();
+}
+
+void GraphOptimizer::Request(const string &dir) {
+    lock_guard<mutex> lock(mutex_);
+    if (stop_ || find(queue_.begin(), queue_.end(), dir) != queue_.end()) return;
+    queue_.push_back(dir);
+    if (!worker_.joinable()) {
+        worker_ = thread(&GraphOptimizer::WorkerLoop, this);
+    }
+    cv_.notify_one();
+}
+
+void GraphOptimizer::Shutdown() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stop_ = true;
+        queue_.clear();
+    }
+    cv_.notify_one();
+    if (worker_.joinable()) worker_.join();
+}
+
+string GraphOptimizer::Prefer(const string &onnx_path) {
+    error_code ec;
+    filesystem::path original = ToPath(onnx_path);
+    filesystem::path optimized = ToPath(onnx_path + kOptimizedSuffix);
+    auto optimized_time = filesystem::last_write_time(optimized, ec);
+    if (ec) return onnx_path;
+    auto original_time = filesystem::last_write_time(original, ec);
+    if (ec || optimized_time < original_time) return onnx_path;
+    return onnx_path + kOptimizedSuffix;
+}
+
+void GraphOptimizer::WorkerLoop() {
+    while (true) {
+        string dir;
+        {
+            unique_lock<mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (stop_) return;
+            dir = queue_.front();
+        }
+        OptimizeDirectory(dir);
+        lock_guard<mutex> lock(mutex_);
+        if (!queue_.empty() && queue_.front() == dir) queue_.pop_front();
+    }
+}
+
+void GraphOptimizer::OptimizeDirectory(const string &dir) {
+    vector<string> files;
+    try {
+        for (const auto &entry : filesystem::directory_iterator(ToPath(dir))) {
+            u8string u8name = entry.path().filename().u8string();
+            string name(u8name.begin(), u8name.end());
+            string path = dir + "/" + name;
+            if (IsTransducerFile(name) && Prefer(path) == path) files.push_back(path);
+        }
+    } catch (...) {}
+    if (files.empty()) return;
+    sort(files.begin(), files.end());
+
+    const OrtApi *api = GetOrtApi();
+    if (!api) {
+        BLOG(LOG_WARNING, "Graph optimization skipped: onnxruntime.dll not loaded or older than API version %d", ORT_API_VERSION);
+        return;
+    }
+    OrtEnv *env = nullptr;
+    if (!Check(api, api->CreateEnv(ORT_LOGGING_LEVEL_WARNING, "profanity-filter-optimizer", &env), "CreateEnv")) return;
+
+    for (const string &file : files) {
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (stop_) break;
+        }
+        // Written under a temporary name, a half-written graph must never be picked up by Prefer
+        string target = file + kOptimizedSuffix;
+        string partial = target + ".tmp";
+        double before_ms = TimeSession(api, env, file);
+        double optimize_ms = (before_ms >= 0.0) ? TimeSession(api, env, file, partial) : -1.0;
+
+        error_code ec;
+        uint64_t original_size = filesystem::file_size(ToPath(file), ec);
+        uint64_t optimized_size = (optimize_ms >= 0.0) ? filesystem::file_size(ToPath(partial), ec) : 0;
+        if (optimize_ms < 0.0 || ec || optimized_size == 0) {
+            filesystem::remove(ToPath(partial), ec);
+            continue;
+        }
+        if ((double)optimized_size > (double)original_size * kMaxGrowth) {
+            BLOG(LOG_INFO, "Graph optimization of %s discarded: %.0f MB -> %.0f MB", file.c_str(),
+                 original_size / (1024.0 * 1024.0), optimized_size / (1024.0 * 1024.0));
+            filesystem::remove(ToPath(partial), ec);
+            continue;
+        }
+        filesystem::rename(ToPath(partial), ToPath(target), ec);
+        if (ec) {
+            filesystem::remove(ToPath(partial), ec);
+            continue;
+        }
+
+        double after_ms = TimeSession(api, env, target);
+        if (after_ms < 0.0) {
+            // Saved but not loadable: leave the original in use
+            filesystem::remove(ToPath(target), ec);
+            continue;
+        }
+        BLOG(LOG_INFO, "Graph optimized: %s, session creation %.0f ms -> %.0f ms (optimizing took %.0f ms)",
+             file.c_str(), before_ms, after_ms, optimize_ms);
+    }
+    api->ReleaseEnv(env);
+}
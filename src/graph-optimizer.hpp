@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Offline graph optimization of installed models.
+// ONNX Runtime re-runs its graph optimizations for every session sherpa-onnx creates. This saves the optimized
+// encoder/decoder/joiner once, next to the originals ("encoder.int8.onnx" -> "encoder.int8.onnx.optimized"),
+// so later loads start from an already fused graph. Runs on a background thread through the ONNX Runtime C API
+// of the onnxruntime.dll that sherpa-onnx ships (resolved at run time, nothing extra is linked).
+class GraphOptimizer {
+public:
+    static GraphOptimizer &Instance();
+
+    // Queues a model directory (ignored if already queued); files with an up-to-date optimized graph are skipped
+    void Request(const std::string &dir);
+
+    // Joins the worker (module unload), the file being optimized is finished first
+    void Shutdown();
+
+    // The optimized graph for onnx_path if one exists and is newer than the original, otherwise onnx_path
+    static std::string Prefer(const std::string &onnx_path);
+
+private:
+    GraphOptimizer() = default;
+    ~GraphOptimizer();
+
+    void WorkerLoop();
+    void OptimizeDirectory(const std::string &dir);
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread worker_;
+    bool stop_ = false;
+    std::deque<std::string> queue_;
+};
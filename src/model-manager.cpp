@@ -1,5 +1,6 @@
 #include "model-manager.hpp"
 #include "logging-macros.hpp"
+#include "graph-optimizer.hpp"
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -54,6 +55,15 @@ void PluginModelManager::LoadModels(const QString &jsonPath) {
                     if (obj.contains("delay")) {
                         info.delay = obj["delay"].toInt();
                     }
+                    if (obj.contains("threads")) {
+                        info.threads = obj["threads"].toInt();
+                    }
+                    if (obj.contains("decoding")) {
+                        info.decoding = obj["decoding"].toString();
+                    }
+                    for (const auto &v : obj["variants"].toArray()) {
+                        info.variants.append(v.toString());
+                    }
                     models.push_back(info);
                 }
             } else {
@@ -95,6 +105,13 @@ void PluginModelManager::LoadModels(const QString &jsonPath) {
     }
     
     BLOG(LOG_INFO, "Total models loaded: %zu", models.size());
+    
+    // Installs that predate graph optimization (or whose optimization was interrupted) catch up in the background
+    for (const auto &m : models) {
+        if (IsModelInstalled(m.id)) {
+            GraphOptimizer::Instance().Request(GetModelPath(m.id).toStdString());
+        }
+    }
 }
 
 const std::vector<ModelInfo>& PluginModelManager::GetModels() const {
@@ -307,6 +324,8 @@ void PluginModelManager::DownloadWorker(QString url, QString destPath) {
                      if (QDir().rename(modelRootPath, finalModelPath)) {
                          BLOG(LOG_INFO, "Model installed to: %s", finalModelPath.toStdString().c_str());
                          emit downloadFinished(currentDownloadId);
+                         // One-time optimization of the ONNX graphs, later loads of this model start faster
+                         GraphOptimizer::Instance().Request(finalModelPath.toStdString());
                          
                          // Clean up temp dir if we moved a subdirectory out of it
                          // If modelRootPath == tempExtractPath, rename moved the whole dir, so tempExtractPath is already gone/invalid
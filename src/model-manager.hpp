@@ -2,6 +2,7 @@
 
 #include <QObject>
 #include <QFile>
+#include <QStringList>
 #include <vector>
 #include <string>
 #include <functional>
@@ -16,6 +17,9 @@ struct ModelInfo {
     QString id; // Folder name
     int offset = 0; // Default offset in ms
     int delay = 500; // Recommended delay in ms
+    int threads = 0; // Recommended inference threads (0 = no recommendation)
+    QString decoding; // Recommended decoding method (empty = no recommendation)
+    QStringList variants; // Precisions shipped in the package, e.g. "int8", "fp32"
 };
 
 class PluginModelManager : public QObject {
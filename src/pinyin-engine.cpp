@@ -0,0 +1,304 @@
+#include "pinyin-engine.hpp"
+#include "utils.hpp"
+#include "logging-macros.hpp"
+
+#include <obs-module.h>
+
+#include <cpp-pinyin/Pinyin.h>
+#include <cpp-pinyin/G2pglobal.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <windows.h>
+
+using namespace std;
+
+// Dummy function to locate the module handle
+static void ModuleLocator() {}
+
+static string FindDictPath() {
+    string dict_path;
+
+    // Method 1: Try OBS data path (Standard Install)
+    char *obs_data_ptr = obs_module_file("dict");
+    if (obs_data_ptr) {
+        if (filesystem::exists(obs_data_ptr)) {
+            dict_path = obs_data_ptr;
+        }
+        bfree(obs_data_ptr);
+    }
+
+    // Method 2: Try next to DLL (Portable / Dev) or Self-contained bundle
+    if (dict_path.empty()) {
+        HMODULE hMod = nullptr;
+        MEMORY_BASIC_INFORMATION mbi;
+        if (VirtualQuery((LPCVOID)&ModuleLocator, &mbi, sizeof(mbi))) {
+            hMod = (HMODULE)mbi.AllocationBase;
+        }
+
+        if (hMod) {
+            char path[MAX_PATH];
+            if (GetModuleFileNameA(hMod, path, MAX_PATH)) {
+                filesystem::path p(path);
+
+                // 1. Check next to DLL (e.g. local build: bin/64bit/dict)
+                filesystem::path p_next = p.parent_path() / "dict";
+                if (filesystem::exists(p_next)) {
+                    dict_path = p_next.string();
+                } else {
+                    // 2. Check standard plugin structure (root/data/dict)
+                    filesystem::path p_bundle = p.parent_path().parent_path().parent_path() / "data" / "dict";
+                    if (filesystem::exists(p_bundle)) {
+                        dict_path = p_bundle.string();
+                    }
+                }
+            }
+        }
+    }
+    return dict_path;
+}
+
+// --- PinyinEngine ---
+
+PinyinEngine &PinyinEngine::Instance() {
+    static PinyinEngine instance;
+    return instance;
+}
+
+bool PinyinEngine::EnsureLoaded() {
+    lock_guard<mutex> lock(mutex_);
+    if (converter_) return true;
+    if (load_attempted_) return false;
+    load_attempted_ = true;
+
+    string dict_path = FindDictPath();
+    if (dict_path.empty()) {
+        BLOG(LOG_ERROR, "Error: Could not find 'dict' directory for Pinyin engine.");
+        return false;
+    }
+
+    Pinyin::setDictionaryPath(dict_path);
+    converter_ = make_unique<Pinyin::Pinyin>();
+    BLOG(LOG_INFO, "Pinyin Engine Initialized from: %s", dict_path.c_str());
+    return true;
+}
+
+bool PinyinEngine::IsLoaded() const {
+    lock_guard<mutex> lock(mutex_);
+    return converter_ != nullptr;
+}
+
+void PinyinEngine::ToSyllables(const string &text, vector<int32_t> &out) {
+    if (!EnsureLoaded()) return;
+
+    Pinyin::PinyinResVector res;
+    {
+        lock_guard<mutex> lock(mutex_);
+        res = converter_->hanziToPinyin(text, Pinyin::ManTone::Style::NORMAL, Pinyin::Error::Default, false, false);
+    }
+    for (const auto &r : res) {
+        if (!r.pinyin.empty() && r.pinyin != " ") {
+            out.push_back(Intern(NormalizePinyin(r.pinyin)));
+        }
+    }
+}
+
+void PinyinEngine::ToTonedPinyin(const string &text, vector<string> &out) {
+    if (!EnsureLoaded()) return;
+
+    Pinyin::PinyinResVector res;
+    {
+        lock_guard<mutex> lock(mutex_);
+        res = converter_->hanziToPinyin(text, Pinyin::ManTone::Style::TONE, Pinyin::Error::Default, false, false);
+    }
+    for (const auto &r : res) {
+        if (!r.pinyin.empty() && r.pinyin != " ") out.push_back(r.pinyin);
+    }
+}
+
+int32_t PinyinEngine::Intern(const string &syllable) {
+    lock_guard<mutex> lock(mutex_);
+    return InternLocked(syllable);
+}
+
+int32_t PinyinEngine::InternLocked(const string &syllable) {
+    auto it = ids_.find(syllable);
+    if (it != ids_.end()) return it->second;
+    int32_t id = (int32_t)names_.size();
+    names_.push_back(syllable);
+    ids_.emplace(syllable, id);
+
+    // Normalized syllables have single-letter initials (zh/ch/sh are folded); zero-initial syllables keep their
+    // first vowel. The trailing '-' keeps these names apart from real syllables such as "a" or "e".
+    // A class is its own class, so this recurses at most once.
+    string initial = syllable.substr(0, 1) + "-";
+    int32_t initial_id = (initial == syllable) ? id : InternLocked(initial);
+    if (initial_ids_.size() <= (size_t)id) initial_ids_.resize((size_t)id + 1, -1);
+    initial_ids_[id] = initial_id;
+    if ((size_t)id < kFastIds) fast_initials_[id].store(initial_id, memory_order_release);
+    return id;
+}
+
+string PinyinEngine::SyllableName(int32_t id) const {
+    lock_guard<mutex> lock(mutex_);
+    return (id >= 0 && (size_t)id < names_.size()) ? names_[id] : string("?");
+}
+
+int32_t PinyinEngine::InitialOf(int32_t id) const {
+    if (id >= 0 && (size_t)id < kFastIds) return fast_initials_[id].load(memory_order_acquire);
+    lock_guard<mutex> lock(mutex_);
+    return (id >= 0 && (size_t)id < initial_ids_.size()) ? initial_ids_[id] : -1;
+}
+
+// --- TokenPinyinTable ---
+
+shared_ptr<const TokenPinyinTable> TokenPinyinTable::LoadOrBuild(const string &model_dir) {
+    if (!PinyinEngine::Instance().EnsureLoaded()) return nullptr;
+
+    auto start = chrono::steady_clock::now();
+    auto table = make_shared<TokenPinyinTable>();
+
+    filesystem::path tokens_path = filesystem::path(model_dir) / "tokens.txt";
+    filesystem::path cache_path = filesystem::path(model_dir) / "tokens.pinyin.txt";
+    if (!table->ReadTokens(tokens_path.string())) return nullptr;
+
+    // Cache is valid only if it is newer than the vocabulary it was built from
+    bool cache_fresh = false;
+    try {
+        cache_fresh = filesystem::exists(cache_path) &&
+            filesystem::last_write_time(cache_path) >= filesystem::last_write_time(tokens_path);
+    } catch(...) {}
+
+    bool from_cache = cache_fresh && table->ReadCache(cache_path.string());
+    if (!from_cache) {
+        table->Build();
+        table->WriteCache(cache_path.string());
+    }
+    table->BuildIndex();
+
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    BLOG(LOG_INFO, "Token pinyin table %s: %zu tokens, %zu syllables (%.1f ms)",
+        from_cache ? "loaded" : "built", table->symbols_.size(), table->syllables_.size(), ms);
+    return table;
+}
+
+bool TokenPinyinTable::ReadTokens(const string &tokens_path) {
+    ifstream f(tokens_path);
+    if (!f.is_open()) return false;
+
+    // Each line: "<symbol> <id>"
+    string line;
+    while (getline(f, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t sp = line.find_last_of(' ');
+        if (sp == string::npos || sp == 0) continue;
+        int id = atoi(line.c_str() + sp + 1);
+        if (id < 0) continue;
+        if ((size_t)id >= symbols_.size()) symbols_.resize(id + 1);
+        symbols_[id] = line.substr(0, sp);
+    }
+    return !symbols_.empty();
+}
+
+bool TokenPinyinTable::ReadCache(const string &cache_path) {
+    ifstream f(cache_path);
+    if (!f.is_open()) return false;
+
+    // Header: "# vocab=<N>", then "<id>\t<syl> <syl> ..." for tokens that have pinyin,
+    // then "# entries=<M>". A file without the trailer was cut short and is rebuilt.
+    string line;
+    if (!getline(f, line) || line != "# vocab=" + to_string(symbols_.size())) return false;
+
+    PinyinEngine &engine = PinyinEngine::Instance();
+    vector<vector<int32_t>> per_token(symbols_.size());
+    size_t entries = 0;
+    bool complete = false;
+    while (getline(f, line)) {
+        if (line.rfind("# entries=", 0) == 0) {
+            complete = line == "# entries=" + to_string(entries);
+            break;
+        }
+        size_t tab = line.find('\t');
+        if (tab == string::npos) continue;
+        int id = atoi(line.c_str());
+        if (id < 0 || (size_t)id >= symbols_.size()) return false;
+        stringstream ss(line.substr(tab + 1));
+        string syl;
+        while (ss >> syl) per_token[id].push_back(engine.Intern(syl));
+        entries++;
+    }
+    if (!complete) return false;
+
+    offsets_.assign(1, 0);
+    syllables_.clear();
+    for (const auto &s : per_token) {
+        syllables_.insert(syllables_.end(), s.begin(), s.end());
+        offsets_.push_back((uint32_t)syllables_.size());
+    }
+    return true;
+}
+
+void TokenPinyinTable::Build() {
+    PinyinEngine &engine = PinyinEngine::Instance();
+    offsets_.assign(1, 0);
+    syllables_.clear();
+    for (const auto &sym : symbols_) {
+        if (!sym.empty()) engine.ToSyllables(sym, syllables_);
+        offsets_.push_back((uint32_t)syllables_.size());
+    }
+}
+
+void TokenPinyinTable::WriteCache(const string &cache_path) const {
+    // Model folder may be read-only (custom path), the table still works from memory.
+    // Written under a temporary name (one per thread, loads of the same model may overlap) and renamed,
+    // so a reader never sees a half-written file.
+    filesystem::path target(cache_path);
+    filesystem::path partial(cache_path + "." + to_string(hash<thread::id>()(this_thread::get_id())) + ".tmp");
+    error_code ec;
+    try {
+        {
+            ofstream f(partial, ios::binary);
+            if (!f.is_open()) return;
+            PinyinEngine &engine = PinyinEngine::Instance();
+            f << "# vocab=" << symbols_.size() << "\n";
+            size_t entries = 0;
+            for (size_t id = 0; id < symbols_.size(); id++) {
+                if (offsets_[id] == offsets_[id + 1]) continue;
+                f << id << "\t";
+                for (uint32_t k = offsets_[id]; k < offsets_[id + 1]; k++) {
+                    if (k != offsets_[id]) f << " ";
+                    f << engine.SyllableName(syllables_[k]);
+                }
+                f << "\n";
+                entries++;
+            }
+            f << "# entries=" << entries << "\n";
+            f.close();
+            if (!f) {
+                filesystem::remove(partial, ec);
+                return;
+            }
+        }
+        filesystem::rename(partial, target, ec);
+        if (ec) filesystem::remove(partial, ec);
+    } catch(...) {
+        filesystem::remove(partial, ec);
+    }
+}
+
+void TokenPinyinTable::BuildIndex() {
+    index_.clear();
+    index_.reserve(symbols_.size());
+    for (size_t id = 0; id < symbols_.size(); id++) {
+        if (!symbols_[id].empty()) index_.emplace(string_view(symbols_[id]), (int32_t)id);
+    }
+}
+
+int32_t TokenPinyinTable::Find(string_view token) const {
+    auto it = index_.find(token);
+    return (it != index_.end()) ? it->second : -1;
+}
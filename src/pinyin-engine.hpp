@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace Pinyin {
+class Pinyin;
+}
+
+// Process-wide pinyin converter plus an interner mapping normalized syllables (after NormalizePinyin) to small integers.
+// Syllable IDs are only meaningful within this process.
+class PinyinEngine {
+public:
+    static PinyinEngine &Instance();
+
+    // Locates the 'dict' directory and creates the converter on first call. Thread-safe.
+    bool EnsureLoaded();
+    bool IsLoaded() const;
+
+    // Hanzi text -> normalized syllable IDs, appended to out. Slow path (dictionary lookup).
+    void ToSyllables(const std::string &text, std::vector<int32_t> &out);
+
+    // Hanzi text -> tone-marked pinyin ("zhōng"), appended to out. Used for keyword spotting tokens.
+    void ToTonedPinyin(const std::string &text, std::vector<std::string> &out);
+
+    int32_t Intern(const std::string &syllable);
+    std::string SyllableName(int32_t id) const;
+
+    // ID of the syllable's initial consonant class (its own ID space, disjoint from syllables).
+    // Computed when the syllable is interned; a lock-free array lookup for the first kFastIds IDs.
+    int32_t InitialOf(int32_t id) const;
+
+private:
+    PinyinEngine() = default;
+
+    static constexpr size_t kFastIds = 4096; // Far above the ~420 toneless syllables plus their initial classes
+
+    int32_t InternLocked(const std::string &syllable); // Requires mutex_
+
+    mutable std::mutex mutex_;
+    std::unique_ptr<Pinyin::Pinyin> converter_;
+    bool load_attempted_ = false;
+
+    std::unordered_map<std::string, int32_t> ids_;
+    std::vector<std::string> names_;
+    std::vector<int32_t> initial_ids_;                          // Indexed by syllable ID (mutex_)
+    std::array<std::atomic<int32_t>, kFastIds> fast_initials_{}; // Copy of initial_ids_ for the first kFastIds IDs
+};
+
+// Model vocabulary (tokens.txt) -> pinyin syllable IDs, computed once per model.
+// Persisted as tokens.pinyin.txt next to the model so later loads skip the dictionary pass.
+// Lookups are a hash probe on the token text plus a flat array slice: no allocation.
+class TokenPinyinTable {
+public:
+    static std::shared_ptr<const TokenPinyinTable> LoadOrBuild(const std::string &model_dir);
+
+    // Token symbol -> token id, -1 if not in the vocabulary
+    int32_t Find(std::string_view token) const;
+
+    const int32_t *SyllablesBegin(int32_t id) const { return syllables_.data() + offsets_[id]; }
+    const int32_t *SyllablesEnd(int32_t id) const { return syllables_.data() + offsets_[id + 1]; }
+
+    size_t VocabSize() const { return symbols_.size(); }
+
+private:
+    bool ReadTokens(const std::string &tokens_path);
+    bool ReadCache(const std::string &cache_path);
+    void Build();
+    void WriteCache(const std::string &cache_path) const;
+    void BuildIndex();
+
+    std::vector<std::string> symbols_;                     // Indexed by token id
+    std::unordered_map<std::string_view, int32_t> index_;  // Views into symbols_
+    std::vector<uint32_t> offsets_;                        // VocabSize() + 1 entries into syllables_
+    std::vector<int32_t> syllables_;
+};
@@ -0,0 +1,130 @@
+#include "pinyin-matcher.hpp"
+#include "pinyin-engine.hpp"
+#include "logging-macros.hpp"
+
+#include <obs-module.h>
+
+#include <chrono>
+
+using namespace std;
+
+// --- PinyinMatcher ---
+
+void PinyinMatcher::Build(const vector<string> &words) {
+    PinyinEngine &engine = PinyinEngine::Instance();
+    automaton_.Clear();
+    patterns_.clear();
+    initials_.Clear();
+    initials_patterns_.clear();
+
+    vector<int32_t> pat;
+    vector<int32_t> initials;
+    for (const auto &w : words) {
+        pat.clear();
+        engine.ToSyllables(w, pat);
+        if (pat.empty()) continue;
+        automaton_.Add(pat.data(), pat.size());
+        patterns_.push_back(pat); // Index matches the automaton's pattern id
+
+        // Single syllables would make every syllable with a common initial suspicious
+        if (pat.size() < 2) continue;
+        initials.clear();
+        for (int32_t s : pat) initials.push_back(engine.InitialOf(s));
+        initials_.Add(initials.data(), initials.size());
+        initials_patterns_.push_back((int32_t)patterns_.size() - 1);
+    }
+    automaton_.Compile();
+    initials_.Compile();
+}
+
+void PinyinMatcher::FindAll(const vector<int32_t> &syllables, vector<Match> &out) const {
+    automaton_.Scan(syllables.data(), syllables.size(), [&](int32_t id, size_t start, size_t len) {
+        out.push_back({start, len, id});
+    });
+}
+
+void PinyinMatcher::FindNear(const vector<int32_t> &syllables, vector<int32_t> &initials, vector<Match> &out) const {
+    if (patterns_.empty() || syllables.empty()) return;
+
+    const PinyinEngine &engine = PinyinEngine::Instance();
+    initials.clear();
+    for (int32_t s : syllables) initials.push_back(engine.InitialOf(s));
+    initials_.Scan(initials.data(), initials.size(), [&](int32_t id, size_t start, size_t len) {
+        out.push_back({start, len, initials_patterns_[id]});
+    });
+
+    // Broken-off prefixes: the automaton was at least two syllables into a pattern and fell back
+    int32_t state = 0;
+    for (size_t i = 0; i < syllables.size(); i++) {
+        size_t depth = automaton_.Depth(state);
+        int32_t next = automaton_.Step(state, syllables[i]);
+        if (depth >= 2 && automaton_.Depth(next) <= depth) {
+            bool complete = false;
+            automaton_.ForEachOutput(state, [&](int32_t, size_t plen) { if (plen == depth) complete = true; });
+            if (!complete) out.push_back({i - depth, depth + 1, -1});
+        }
+        state = next;
+    }
+}
+
+// --- SharedPinyinMatcher ---
+
+SharedPinyinMatcher &SharedPinyinMatcher::Instance() {
+    static SharedPinyinMatcher instance;
+    return instance;
+}
+
+SharedPinyinMatcher::~SharedPinyinMatcher() {
+    Shutdown();
+}
+
+void SharedPinyinMatcher::RequestRebuild(vector<string> words) {
+    lock_guard<mutex> lock(mutex_);
+    if (stop_) return;
+    // Settings are saved as a whole, skip rebuilds when the word list itself did not change
+    if (current_ && !pending_ && words == built_words_) return;
+    pending_words_ = std::move(words);
+    pending_ = true;
+    if (!worker_.joinable()) {
+        worker_ = thread(&SharedPinyinMatcher::WorkerLoop, this);
+    }
+    cv_.notify_one();
+}
+
+shared_ptr<const PinyinMatcher> SharedPinyinMatcher::Get() const {
+    lock_guard<mutex> lock(mutex_);
+    return current_;
+}
+
+void SharedPinyinMatcher::Shutdown() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    if (worker_.joinable()) worker_.join();
+}
+
+void SharedPinyinMatcher::WorkerLoop() {
+    while (true) {
+        vector<string> words;
+        {
+            unique_lock<mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stop_ || pending_; });
+            if (stop_) return;
+            words = std::move(pending_words_);
+            pending_ = false;
+        }
+
+        auto start = chrono::steady_clock::now();
+        auto matcher = make_shared<PinyinMatcher>();
+        matcher->Build(words);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        lock_guard<mutex> lock(mutex_);
+        matcher->generation_ = ++builds_;
+        BLOG(LOG_INFO, "Pinyin matcher built: %zu patterns (%.1f ms)", matcher->PatternCount(), ms);
+        current_ = matcher;
+        built_words_ = std::move(words);
+    }
+}
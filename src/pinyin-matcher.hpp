@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+#include "aho-corasick.hpp"
+
+// Dirty words compiled to pinyin syllable IDs (see PinyinEngine) and matched with one automaton,
+// so a scan is linear in the transcript length regardless of list size.
+class PinyinMatcher {
+public:
+    struct Match {
+        size_t start;    // Index into the scanned syllable sequence
+        size_t length;   // In syllables
+        int32_t pattern; // See Pattern()
+    };
+
+    // Slow: every word goes through the pinyin dictionary
+    void Build(const std::vector<std::string> &words);
+
+    // Appends all matches in syllables to out
+    void FindAll(const std::vector<int32_t> &syllables, std::vector<Match> &out) const;
+
+    // Near misses for the model cascade, appended to out (may overlap exact matches):
+    // the initials of a multi-syllable pattern match (the recognizer confused a final or tone), or at least
+    // two syllables of a longer pattern match and then break off. pattern is -1 for the latter.
+    // initials: scratch reused by the caller (no allocation once it has grown).
+    void FindNear(const std::vector<int32_t> &syllables, std::vector<int32_t> &initials, std::vector<Match> &out) const;
+
+    const std::vector<int32_t> &Pattern(int32_t id) const { return patterns_[id]; }
+    size_t PatternCount() const { return patterns_.size(); }
+    size_t MaxPatternLength() const { return automaton_.MaxPatternLength(); }
+
+    // Distinguishes successive builds (readers rescan when this changes)
+    uint64_t Generation() const { return generation_; }
+
+private:
+    friend class SharedPinyinMatcher;
+
+    AhoCorasick<int32_t> automaton_;
+    std::vector<std::vector<int32_t>> patterns_;
+    AhoCorasick<int32_t> initials_;          // Multi-syllable patterns as initial-class sequences
+    std::vector<int32_t> initials_patterns_; // initials_ pattern id -> Pattern() id
+    uint64_t generation_ = 0;
+};
+
+// Process-wide PinyinMatcher shared by all filter instances.
+// Rebuilds run on a background thread so saving settings never waits on the dictionary;
+// requests arriving during a build are coalesced and only the latest word list is compiled.
+class SharedPinyinMatcher {
+public:
+    static SharedPinyinMatcher &Instance();
+
+    void RequestRebuild(std::vector<std::string> words);
+
+    // Current snapshot, nullptr until the first build completes
+    std::shared_ptr<const PinyinMatcher> Get() const;
+
+    // Joins the worker (module unload)
+    void Shutdown();
+
+private:
+    SharedPinyinMatcher() = default;
+    ~SharedPinyinMatcher();
+
+    void WorkerLoop();
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread worker_;
+    bool stop_ = false;
+    bool pending_ = false;
+    std::vector<std::string> pending_words_;
+    std::vector<std::string> built_words_;
+    uint64_t builds_ = 0;
+    std::shared_ptr<const PinyinMatcher> current_;
+};
@@ -1,6 +1,9 @@
 #include "plugin-config.hpp"
 #include "video-delay.hpp"
 #include "profanity-filter.hpp"
+#include "pinyin-matcher.hpp"
+#include "asr-worker-pool.hpp"
+#include "graph-optimizer.hpp"
 #include "logging-macros.hpp"
 #include <obs-module.h>
 #include <obs.h>
@@ -8,6 +11,7 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 #include <QPointer>
 
 using namespace std;
@@ -32,7 +36,6 @@ void SetGlobalConfigModule(obs_module_t *module) {
 }
 
 void GlobalConfig::ParsePatterns() {
-    dirty_patterns.clear();
     
     // Combine system and user dirty words
     std::string combined = system_dirty_words_str;
@@ -44,6 +47,7 @@ void GlobalConfig::ParsePatterns() {
     // Update the legacy string just in case
     dirty_words_str = combined;
 
+    vector<string> words;
     stringstream ss(combined);
     string item;
     while (getline(ss, item, ',')) {
@@ -51,24 +55,53 @@ void GlobalConfig::ParsePatterns() {
         item.erase(0, item.find_first_not_of(" \t\n\r"));
         item.erase(item.find_last_not_of(" \t\n\r") + 1);
         if (!item.empty()) {
-            try {
-                dirty_patterns.emplace_back(item, regex::icase);
-            } catch(...) {}
+            words.push_back(item);
         }
     }
+    
+    // Literal words share one automaton; only entries with regex syntax are compiled as std::regex
+    auto matcher = make_shared<WordMatcher>();
+    matcher->Build(words);
+    BLOG(LOG_INFO, "Dirty word matcher built: %zu literal, %zu regex", matcher->LiteralCount(), matcher->RegexCount());
+    word_matcher = matcher;
+    word_list = make_shared<const vector<string>>(words);
+    words_generation++;
+
+    // Pinyin patterns need the dictionary, compiled on a background thread and picked up by the filters when ready
+    SharedPinyinMatcher::Instance().RequestRebuild(std::move(words));
 }
 
 void GlobalConfig::Save() {
     obs_data_t *data = obs_data_create();
     string path_to_save;
     string custom_words_path;
+    int worker_threads;
+    int cache_ttl_s;
+    int cache_mb;
     
     {
         lock_guard<std::mutex> lock(this->mutex);
         
         obs_data_set_bool(data, "global_enable", global_enable);
         obs_data_set_string(data, "model_path", model_path.c_str());
+        obs_data_set_int(data, "engine_mode", engine_mode);
+        obs_data_set_string(data, "cascade_model_path", cascade_model_path.c_str());
+        obs_data_set_double(data, "hotword_score", hotword_score);
         obs_data_set_int(data, "model_offset_ms", model_offset_ms);
+        obs_data_set_int(data, "asr_min_chunk_ms", asr_min_chunk_ms);
+        obs_data_set_int(data, "asr_worker_threads", asr_worker_threads);
+        worker_threads = asr_worker_threads;
+        obs_data_set_int(data, "onnx_threads", onnx_threads);
+        obs_data_set_string(data, "onnx_provider", onnx_provider.c_str());
+        obs_data_set_string(data, "decoding_method", decoding_method.c_str());
+        obs_data_set_int(data, "max_active_paths", max_active_paths);
+        obs_data_set_int(data, "endpoint_rule1_ms", endpoint_rule1_ms);
+        obs_data_set_int(data, "endpoint_rule2_ms", endpoint_rule2_ms);
+        obs_data_set_bool(data, "prefer_int8", prefer_int8);
+        obs_data_set_int(data, "model_cache_ttl_s", model_cache_ttl_s);
+        obs_data_set_int(data, "model_cache_mb", model_cache_mb);
+        cache_ttl_s = model_cache_ttl_s;
+        cache_mb = model_cache_mb;
         obs_data_set_double(data, "delay_seconds", delay_seconds);
         // dirty_words stored in external files now
         obs_data_set_bool(data, "use_pinyin", use_pinyin);
@@ -77,10 +110,15 @@ void GlobalConfig::Save() {
         obs_data_set_int(data, "beep_freq", beep_frequency);
         obs_data_set_int(data, "beep_mix", beep_mix_percent);
         obs_data_set_bool(data, "enable_agc", enable_agc);
+        obs_data_set_bool(data, "enable_vad", enable_vad);
         obs_data_set_bool(data, "video_delay_enabled", video_delay_enabled);
         
         ParsePatterns();
     }
+    // Outside the config lock: resizing joins workers, which take that lock themselves
+    ASRWorkerPool::Instance().SetThreadCount(worker_threads);
+    ModelManager::SetRetention(cache_ttl_s, cache_mb);
+    ProfanityFilter::ReserveDelayLines();
     
     // Save Custom Dirty Words to custom_dirty_words.txt
     if (g_module) {
@@ -128,7 +166,7 @@ void GlobalConfig::Save() {
 }
 
 void GlobalConfig::Load() {
-    lock_guard<std::mutex> lock(this->mutex);
+    unique_lock<std::mutex> lock(this->mutex);
     
     // Helper to get config path
     auto get_config_path = [](const char* filename) -> string {
@@ -222,10 +260,61 @@ void GlobalConfig::Load() {
         const char* s = obs_data_get_string(data, "model_path");
         model_path = s ? s : "";
         
+        if (obs_data_has_user_value(data, "engine_mode")) {
+            engine_mode = (obs_data_get_int(data, "engine_mode") == 1) ? 1 : 0;
+        }
+        
+        const char* cascade = obs_data_get_string(data, "cascade_model_path");
+        cascade_model_path = cascade ? cascade : "";
+        
+        if (obs_data_has_user_value(data, "hotword_score")) {
+            hotword_score = obs_data_get_double(data, "hotword_score");
+        }
+        
         if (obs_data_has_user_value(data, "model_offset_ms")) {
             model_offset_ms = obs_data_get_int(data, "model_offset_ms");
         }
 
+        if (obs_data_has_user_value(data, "asr_min_chunk_ms")) {
+            asr_min_chunk_ms = (int)obs_data_get_int(data, "asr_min_chunk_ms");
+            if (asr_min_chunk_ms < 20) asr_min_chunk_ms = 20;
+            if (asr_min_chunk_ms > 500) asr_min_chunk_ms = 500;
+        }
+
+        if (obs_data_has_user_value(data, "asr_worker_threads")) {
+            asr_worker_threads = (int)obs_data_get_int(data, "asr_worker_threads");
+            if (asr_worker_threads < 1) asr_worker_threads = 1;
+            if (asr_worker_threads > 8) asr_worker_threads = 8;
+        }
+
+        if (obs_data_has_user_value(data, "onnx_threads")) {
+            onnx_threads = std::clamp((int)obs_data_get_int(data, "onnx_threads"), 0, 16);
+        }
+        if (obs_data_has_user_value(data, "onnx_provider")) {
+            onnx_provider = obs_data_get_string(data, "onnx_provider");
+        }
+        if (obs_data_has_user_value(data, "decoding_method")) {
+            decoding_method = obs_data_get_string(data, "decoding_method");
+        }
+        if (obs_data_has_user_value(data, "max_active_paths")) {
+            max_active_paths = std::clamp((int)obs_data_get_int(data, "max_active_paths"), 1, 16);
+        }
+        if (obs_data_has_user_value(data, "endpoint_rule1_ms")) {
+            endpoint_rule1_ms = std::clamp((int)obs_data_get_int(data, "endpoint_rule1_ms"), 200, 10000);
+        }
+        if (obs_data_has_user_value(data, "endpoint_rule2_ms")) {
+            endpoint_rule2_ms = std::clamp((int)obs_data_get_int(data, "endpoint_rule2_ms"), 200, 10000);
+        }
+        if (obs_data_has_user_value(data, "prefer_int8")) {
+            prefer_int8 = obs_data_get_bool(data, "prefer_int8");
+        }
+        if (obs_data_has_user_value(data, "model_cache_ttl_s")) {
+            model_cache_ttl_s = std::clamp((int)obs_data_get_int(data, "model_cache_ttl_s"), 0, 3600);
+        }
+        if (obs_data_has_user_value(data, "model_cache_mb")) {
+            model_cache_mb = std::clamp((int)obs_data_get_int(data, "model_cache_mb"), 0, 16384);
+        }
+
         delay_seconds = obs_data_get_double(data, "delay_seconds");
         if (delay_seconds < 0.01) delay_seconds = 0.5;
         
@@ -251,6 +340,10 @@ void GlobalConfig::Load() {
             enable_agc = obs_data_get_bool(data, "enable_agc");
         }
 
+        if (obs_data_has_user_value(data, "enable_vad")) {
+            enable_vad = obs_data_get_bool(data, "enable_vad");
+        }
+
         if (obs_data_has_user_value(data, "video_delay_enabled")) {
             video_delay_enabled = obs_data_get_bool(data, "video_delay_enabled");
         }
@@ -260,6 +353,14 @@ void GlobalConfig::Load() {
     
     ParsePatterns();
     loaded = true;
+    int worker_threads = asr_worker_threads;
+    int cache_ttl_s = model_cache_ttl_s;
+    int cache_mb = model_cache_mb;
+    
+    // Outside the config lock, as in Save: resizing joins workers, which take that lock themselves
+    lock.unlock();
+    ASRWorkerPool::Instance().SetThreadCount(worker_threads);
+    ModelManager::SetRetention(cache_ttl_s, cache_mb);
 }
 
 // --- UI Implementation ---
@@ -343,6 +444,28 @@ ConfigDialog::ConfigDialog(QWidget *parent) : QDialog(parent) {
     boxDownload->addStretch();
     
     layoutModel->addRow("选择模型:", comboModel);
+    
+    comboEngine = new QComboBox();
+    comboEngine->addItem("完整语音识别 (Transducer)", 0);
+    comboEngine->addItem("关键词检测 (KWS, 低CPU)", 1);
+    comboEngine->setToolTip("完整语音识别: 识别全部文本后匹配脏话，支持拼音/正则匹配。\n关键词检测: 只检测脏话列表中的词，CPU占用低得多，需要选择 KWS 模型 (如 sherpa-onnx-kws-zipformer)。\n关键词检测模式不支持正则表达式词条。");
+    layoutModel->addRow("识别引擎:", comboEngine);
+    
+    spinHotwordScore = new QDoubleSpinBox();
+    spinHotwordScore->setRange(0.0, 5.0);
+    spinHotwordScore->setSingleStep(0.5);
+    spinHotwordScore->setDecimals(1);
+    spinHotwordScore->setSpecialValueText("关闭");
+    spinHotwordScore->setToolTip("热词增强 (仅完整语音识别)\n把脏话列表作为热词，让识别结果偏向这些词，小模型也能达到更高的检出率。\n越大: 越容易识别出脏话，但误报也会增加\n0: 关闭");
+    layoutModel->addRow("热词增强:", spinHotwordScore);
+    
+    comboCascade = new QComboBox();
+    comboCascade->addItem("不使用", "");
+    for (const auto &m : loadedModels) {
+        comboCascade->addItem(m.name, modelManager->GetModelPath(m.id));
+    }
+    comboCascade->setToolTip("级联复核 (可选)\n上面选择的模型持续运行，只有疑似脏话 (拼音近似、词语只匹配了一半、关键词命中) 的片段才交给此大模型重新识别。\n只有这些片段消耗大模型的CPU；关键词命中会立即屏蔽，复核未确认时在播出前撤销。\n需要开启拼音匹配，应选择比主模型更大的完整识别模型。");
+    layoutModel->addRow("级联复核模型:", comboCascade);
     lblPathTitle = new QLabel("模型路径:");
     layoutModel->addRow(lblPathTitle, boxPath);
 
@@ -352,6 +475,79 @@ ConfigDialog::ConfigDialog(QWidget *parent) : QDialog(parent) {
     spinModelOffset->setSuffix(" ms");
     spinModelOffset->setToolTip("模型延迟补偿 (Offset)\n不同模型可能有不同的处理延迟，导致哔声位置偏移。\n调整此值可校准哔声位置。\n正值: 哔声延后\n负值: 哔声提前");
     layoutModel->addRow("延迟补偿:", spinModelOffset);
+
+    spinAsrChunk = new QSpinBox();
+    spinAsrChunk->setRange(20, 500);
+    spinAsrChunk->setSingleStep(10);
+    spinAsrChunk->setSuffix(" ms");
+    spinAsrChunk->setToolTip("识别分块大小\n累积到该时长的音频后立即唤醒识别线程。\n越小: 检测延迟越低，可适当减小全局延迟，但CPU占用更高\n越大: CPU占用更低，检测延迟更高");
+    layoutModel->addRow("识别分块:", spinAsrChunk);
+
+    spinAsrThreads = new QSpinBox();
+    spinAsrThreads->setRange(1, 8);
+    spinAsrThreads->setToolTip("识别线程数 (所有来源共享)\n多个来源使用同一模型时会合并为一次批量识别。\n来源较多或CPU核心充足时可适当增加，避免与编码器争抢CPU。");
+    layoutModel->addRow("识别线程数:", spinAsrThreads);
+
+    spinOnnxThreads = new QSpinBox();
+    spinOnnxThreads->setRange(0, 16);
+    spinOnnxThreads->setSpecialValueText("自动");
+    spinOnnxThreads->setToolTip("单个模型的推理线程数\n大模型在多核机器上可适当增加；笔记本建议保持较小。\n自动: 根据实测实时率 (RTF) 自动调整");
+    layoutModel->addRow("推理线程:", spinOnnxThreads);
+
+    comboDecoding = new QComboBox();
+    comboDecoding->addItem("自动 (按实时率选择)", "auto");
+    comboDecoding->addItem("束搜索 (modified_beam_search, 更准)", "modified_beam_search");
+    comboDecoding->addItem("贪心搜索 (greedy_search, 更省CPU)", "greedy_search");
+    comboDecoding->setToolTip("解码方式 (仅完整语音识别)\n束搜索更准确，且热词增强只在束搜索下生效；贪心搜索CPU占用更低。");
+    layoutModel->addRow("解码方式:", comboDecoding);
+
+    spinMaxPaths = new QSpinBox();
+    spinMaxPaths->setRange(1, 16);
+    spinMaxPaths->setToolTip("束宽 (max_active_paths)\n越大越准确，CPU占用越高。");
+    layoutModel->addRow("束宽:", spinMaxPaths);
+
+    comboProvider = new QComboBox();
+    comboProvider->addItem("CPU", "cpu");
+    comboProvider->addItem("XNNPACK (CPU)", "xnnpack");
+    comboProvider->addItem("DirectML (GPU)", "directml");
+    comboProvider->addItem("CUDA (GPU)", "cuda");
+    comboProvider->setToolTip("推理后端\n所用 sherpa-onnx 库不支持时会自动回退到 CPU (见日志)。");
+    layoutModel->addRow("推理后端:", comboProvider);
+
+    QHBoxLayout *boxEndpoint = new QHBoxLayout();
+    spinEndpointRule1 = new QSpinBox();
+    spinEndpointRule1->setRange(200, 10000);
+    spinEndpointRule1->setSingleStep(100);
+    spinEndpointRule1->setSuffix(" ms");
+    spinEndpointRule1->setToolTip("未识别到内容时，静音多久后结束当前句");
+    spinEndpointRule2 = new QSpinBox();
+    spinEndpointRule2->setRange(200, 10000);
+    spinEndpointRule2->setSingleStep(100);
+    spinEndpointRule2->setSuffix(" ms");
+    spinEndpointRule2->setToolTip("识别到内容后，静音多久后结束当前句");
+    boxEndpoint->addWidget(spinEndpointRule1);
+    boxEndpoint->addWidget(spinEndpointRule2);
+    layoutModel->addRow("断句静音:", boxEndpoint);
+
+    chkPreferInt8 = new QCheckBox("优先使用 int8 量化模型");
+    chkPreferInt8->setToolTip("模型包含 *.int8.onnx 时优先加载，内存占用和识别耗时明显更低，准确率略有下降。\n日志中会记录加载耗时/内存和识别实时率 (RTF)，可对比两种精度。");
+    layoutModel->addRow("", chkPreferInt8);
+
+    QHBoxLayout *boxCache = new QHBoxLayout();
+    spinCacheTtl = new QSpinBox();
+    spinCacheTtl->setRange(0, 3600);
+    spinCacheTtl->setSingleStep(60);
+    spinCacheTtl->setSuffix(" 秒");
+    spinCacheTtl->setSpecialValueText("不保留");
+    spinCacheTtl->setToolTip("不再使用的模型在内存中保留多久\n切换场景集合、关闭再开启屏蔽时无需重新加载模型。");
+    spinCacheMb = new QSpinBox();
+    spinCacheMb->setRange(0, 16384);
+    spinCacheMb->setSingleStep(256);
+    spinCacheMb->setSuffix(" MB");
+    spinCacheMb->setToolTip("模型缓存内存上限\n超出时优先释放最久未使用的空闲模型 (正在使用的模型不受影响)。\n命中率和占用见日志 [ModelManager]。");
+    boxCache->addWidget(spinCacheTtl);
+    boxCache->addWidget(spinCacheMb);
+    layoutModel->addRow("模型缓存:", boxCache);
     
     layoutModel->addRow("", boxDownload);
     
@@ -369,6 +565,9 @@ ConfigDialog::ConfigDialog(QWidget *parent) : QDialog(parent) {
     chkEnableAGC = new QCheckBox("启用自动增益 (Auto Gain Control)");
     chkEnableAGC->setToolTip("开启后，将自动调整音量以保持稳定的识别效果。\n(推荐开启，可解决声音过小导致识别不到的问题)");
 
+    chkEnableVAD = new QCheckBox("启用人声检测 (VAD)，跳过静音/非人声片段");
+    chkEnableVAD->setToolTip("开启后，仅在检测到人声时才进行语音识别，可大幅降低CPU占用。\n需要 silero_vad.onnx (放在插件 data 目录或模型目录)。");
+
     // Audio Effect Selection
     comboEffect = new QComboBox();
     comboEffect->addItem("标准哔声 (Beep)", 0);
@@ -378,6 +577,7 @@ ConfigDialog::ConfigDialog(QWidget *parent) : QDialog(parent) {
     
     layoutAudio->addRow("全局延迟时间:", spinDelay);
     layoutAudio->addRow("", chkEnableAGC);
+    layoutAudio->addRow("", chkEnableVAD);
     layoutAudio->addRow("屏蔽音效:", comboEffect);
     
     chkEnableVideoDelay = new QCheckBox("启用音画同步缓冲 (自动应用到所有场景)");
@@ -523,8 +723,32 @@ void ConfigDialog::LoadToUI() {
     }
     
     spinModelOffset->setValue(cfg->model_offset_ms);
+    int engine_idx = comboEngine->findData(cfg->engine_mode);
+    comboEngine->setCurrentIndex(engine_idx != -1 ? engine_idx : 0);
+    QString cascadePath = QString::fromStdString(cfg->cascade_model_path);
+    int cascade_idx = comboCascade->findData(cascadePath);
+    if (cascade_idx == -1 && !cascadePath.isEmpty()) {
+        comboCascade->addItem(cascadePath, cascadePath); // Custom path from the config file
+        cascade_idx = comboCascade->count() - 1;
+    }
+    comboCascade->setCurrentIndex(cascade_idx != -1 ? cascade_idx : 0);
+    spinHotwordScore->setValue(cfg->hotword_score);
+    spinAsrChunk->setValue(cfg->asr_min_chunk_ms);
+    spinAsrThreads->setValue(cfg->asr_worker_threads);
+    spinOnnxThreads->setValue(cfg->onnx_threads);
+    int decoding_idx = comboDecoding->findData(QString::fromStdString(cfg->decoding_method));
+    comboDecoding->setCurrentIndex(decoding_idx != -1 ? decoding_idx : 0);
+    spinMaxPaths->setValue(cfg->max_active_paths);
+    int provider_idx = comboProvider->findData(QString::fromStdString(cfg->onnx_provider));
+    comboProvider->setCurrentIndex(provider_idx != -1 ? provider_idx : 0);
+    spinEndpointRule1->setValue(cfg->endpoint_rule1_ms);
+    spinEndpointRule2->setValue(cfg->endpoint_rule2_ms);
+    chkPreferInt8->setChecked(cfg->prefer_int8);
+    spinCacheTtl->setValue(cfg->model_cache_ttl_s);
+    spinCacheMb->setValue(cfg->model_cache_mb);
     spinDelay->setValue((int)(cfg->delay_seconds * 1000));
     chkEnableAGC->setChecked(cfg->enable_agc);
+    chkEnableVAD->setChecked(cfg->enable_vad);
     
     // Ensure we are in visible mode before setting text to avoid overwriting "Hidden" text
     chkHideDirtyWords->setChecked(false); 
@@ -576,6 +800,7 @@ void ConfigDialog::updateStatus() {
     } else {
         lblVideoMemory->setStyleSheet("color: #888; font-style: italic;");
     }
+    text += QString(" | 音频延迟缓冲: %1 MB").arg(ProfanityFilter::total_delay_memory_mb.load(), 0, 'f', 1);
     lblVideoMemory->setText(text);
 }
 
@@ -591,6 +816,13 @@ void ConfigDialog::onModelComboChanged(int index) {
                 // Actually, LoadToUI sets the saved value AFTER this, so it's safe to always set here.
                 spinModelOffset->setValue(m.offset);
                 
+                // Recommended decode settings, unless the user left them on auto
+                if (m.threads > 0 && spinOnnxThreads->value() != 0) spinOnnxThreads->setValue(m.threads);
+                int decoding_idx = comboDecoding->findData(m.decoding);
+                if (decoding_idx != -1 && comboDecoding->currentData().toString() != "auto") {
+                    comboDecoding->setCurrentIndex(decoding_idx);
+                }
+                
                 // Also suggest/set recommended delay if current delay is less than recommended
                 int recommended = m.delay;
                 if (spinDelay->value() < recommended) {
@@ -624,7 +856,11 @@ void ConfigDialog::onModelComboChanged(int index) {
         
         if (installed) {
             btnDownloadModel->setText("🗑️ 删除模型");
-            lblDownloadStatus->setText("✅ 已安装 (Ready)");
+            bool has_int8 = false;
+            for (const auto &m : modelManager->GetModels()) {
+                if (m.id == id) has_int8 = m.variants.contains("int8");
+            }
+            lblDownloadStatus->setText(has_int8 ? "✅ 已安装 (Ready) · 含 int8" : "✅ 已安装 (Ready)");
             lblDownloadStatus->setVisible(true);
         } else {
             btnDownloadModel->setText("⬇️ 一键下载此模型");
@@ -739,8 +975,23 @@ void ConfigDialog::onApply() {
         cfg->global_enable = chkGlobalEnable->isChecked();
         cfg->model_path = editModelPath->text().toStdString();
         cfg->model_offset_ms = spinModelOffset->value();
+        cfg->engine_mode = comboEngine->currentData().toInt();
+        cfg->cascade_model_path = comboCascade->currentData().toString().toStdString();
+        cfg->hotword_score = spinHotwordScore->value();
+        cfg->asr_min_chunk_ms = spinAsrChunk->value();
+        cfg->asr_worker_threads = spinAsrThreads->value();
+        cfg->onnx_threads = spinOnnxThreads->value();
+        cfg->decoding_method = comboDecoding->currentData().toString().toStdString();
+        cfg->max_active_paths = spinMaxPaths->value();
+        cfg->onnx_provider = comboProvider->currentData().toString().toStdString();
+        cfg->endpoint_rule1_ms = spinEndpointRule1->value();
+        cfg->endpoint_rule2_ms = spinEndpointRule2->value();
+        cfg->prefer_int8 = chkPreferInt8->isChecked();
+        cfg->model_cache_ttl_s = spinCacheTtl->value();
+        cfg->model_cache_mb = spinCacheMb->value();
         cfg->delay_seconds = (double)spinDelay->value() / 1000.0;
         cfg->enable_agc = chkEnableAGC->isChecked();
+        cfg->enable_vad = chkEnableVAD->isChecked();
         
         if (chkHideDirtyWords->isChecked()) {
             cfg->user_dirty_words_str = m_cachedUserWords.toStdString();
@@ -771,9 +1022,15 @@ void ConfigDialog::onSave() {
 
 void InitGlobalConfig() {
     GetGlobalConfig()->Load();
+    // The pinyin dictionary is already being loaded by Load (matcher build), start on the model too
+    ProfanityFilter::PreloadModels();
 }
 
 void FreeGlobalConfig() {
+    ASRWorkerPool::Instance().Shutdown();
+    SharedPinyinMatcher::Instance().Shutdown();
+    ModelManager::Shutdown();
+    GraphOptimizer::Instance().Shutdown();
     if (g_config) {
         delete g_config;
         g_config = nullptr;
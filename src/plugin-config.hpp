@@ -22,11 +22,12 @@
 #include <QProgressBar>
 
 #include "model-manager.hpp"
+#include "word-matcher.hpp"
 
 #include <string>
 #include <vector>
 #include <mutex>
-#include <regex>
+#include <memory>
 
 // Global Configuration Structure
 struct GlobalConfig {
@@ -36,7 +37,21 @@ struct GlobalConfig {
     // Settings
     bool global_enable = true;
     std::string model_path;
+    int engine_mode = 0; // EngineMode: 0=Transducer (full ASR), 1=Keyword spotter (KWS model required)
+    std::string cascade_model_path; // Large transducer that re-checks suspicious windows (empty = cascade off)
+    double hotword_score = 1.5; // Contextual biasing of the transducer towards the word list (0 = off)
     int model_offset_ms = 0; // Model latency compensation
+    int asr_min_chunk_ms = 100; // ASR wakes once this much audio is queued (lower = less latency, more CPU)
+    int asr_worker_threads = 2; // Shared ASR worker pool size (all sources)
+    int onnx_threads = 0; // Intra-op threads per model, 0 = auto (AutoTuner)
+    std::string onnx_provider = "cpu"; // cpu, xnnpack, directml, cuda
+    std::string decoding_method = "auto"; // auto, modified_beam_search, greedy_search
+    int max_active_paths = 4; // Beam size for modified_beam_search
+    int endpoint_rule1_ms = 2400; // Trailing silence ending a segment with nothing decoded
+    int endpoint_rule2_ms = 1200; // Trailing silence ending a segment after speech
+    bool prefer_int8 = true; // Load *.int8.onnx when the model package ships them
+    int model_cache_ttl_s = 600; // Unused models stay loaded this long (scene switches, toggling the filter)
+    int model_cache_mb = 1024; // Memory budget of the model cache, idle models are evicted beyond it
     double delay_seconds = 0.5;
     std::string dirty_words_str; // Combined (for internal use)
     std::string system_dirty_words_str; // Read-only built-in
@@ -45,12 +60,15 @@ struct GlobalConfig {
     int beep_frequency = 1000;
     int beep_mix_percent = 100;
     bool enable_agc = true; // Automatic Gain Control (Default: ON)
+    bool enable_vad = false; // Skip ASR on non-speech audio (needs silero_vad.onnx)
     bool use_pinyin = true;
     bool comedy_mode = false;
     bool video_delay_enabled = true;
     
-    // Parsed State
-    std::vector<std::regex> dirty_patterns;
+    // Parsed State (immutable once published, readers copy the pointer under mutex)
+    std::shared_ptr<const WordMatcher> word_matcher;
+    std::shared_ptr<const std::vector<std::string>> word_list; // Trimmed combined list (keyword spotting)
+    uint64_t words_generation = 0; // Bumped whenever the word list is re-parsed
     
     mutable std::mutex mutex;
 
@@ -84,7 +102,21 @@ private slots:
 private:
     QCheckBox *chkGlobalEnable;
     QComboBox *comboModel; // Replaces editModelPath for main selection
+    QComboBox *comboEngine;
+    QComboBox *comboCascade;
+    QDoubleSpinBox *spinHotwordScore;
     QSpinBox *spinModelOffset; // Added for model latency calibration
+    QSpinBox *spinAsrChunk;
+    QSpinBox *spinAsrThreads;
+    QSpinBox *spinOnnxThreads;
+    QComboBox *comboDecoding;
+    QSpinBox *spinMaxPaths;
+    QComboBox *comboProvider;
+    QSpinBox *spinEndpointRule1;
+    QSpinBox *spinEndpointRule2;
+    QCheckBox *chkPreferInt8;
+    QSpinBox *spinCacheTtl;
+    QSpinBox *spinCacheMb;
     QLineEdit *editModelPath; // Hidden or advanced
     QPushButton *btnDownloadModel;
     QProgressBar *progressDownload;
@@ -95,6 +127,7 @@ private:
     
     QSpinBox *spinDelay;
     QCheckBox *chkEnableAGC;
+    QCheckBox *chkEnableVAD;
     QTextEdit *editDirtyWords; // User Custom Words
     QTextEdit *editSystemDirtyWords; // System Built-in Words (Read-only)
     QCheckBox *chkHideDirtyWords;
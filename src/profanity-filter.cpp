@@ -2,26 +2,24 @@
 #include "plugin-config.hpp"
 #include "utils.hpp"
 #include "logging-macros.hpp"
+#include "asr-worker-pool.hpp"
+#include "auto-tuner.hpp"
 
 #include <obs-module.h>
 #include <obs-frontend-api.h>
 
-#include <cpp-pinyin/G2pglobal.h>
-
-// Dummy function to locate the module handle
-static void ModuleLocator() {}
-
 #include <sstream>
+#include <cstring>
 #include <cmath>
 #include <algorithm>
-#include <regex>
-#include <filesystem>
-#include <windows.h>
 
 using namespace std;
 
 std::set<ProfanityFilter*> ProfanityFilter::instances;
 std::mutex ProfanityFilter::instances_mutex;
+std::shared_future<ModelLoad> ProfanityFilter::preload;
+std::string ProfanityFilter::preload_path;
+std::atomic<double> ProfanityFilter::total_delay_memory_mb{0.0};
 
 ProfanityFilter::ProfanityFilter(obs_source_t *ctx) : context(ctx) {
     {
@@ -29,10 +27,22 @@ ProfanityFilter::ProfanityFilter(obs_source_t *ctx) : context(ctx) {
         instances.insert(this);
     }
     // Initial sync with global config
-    GlobalConfig *cfg = GetGlobalConfig();
-    lock_guard<mutex> lock(cfg->mutex);
-    target_model_path = cfg->model_path;
-    cached_delay = cfg->delay_seconds;
+    {
+        GlobalConfig *cfg = GetGlobalConfig();
+        lock_guard<mutex> lock(cfg->mutex);
+        target_model_path = cfg->model_path;
+        cached_delay = cfg->delay_seconds;
+    }
+    // Preallocate for the default rate so the first audio callback does not build the filter bank
+    // (ReserveDelayLine below prepares another one if OBS runs at a different rate)
+    resampler.Configure(48000, 16000);
+    resampler_rate = 48000;
+    asr_scratch.resize(4096 + 1); // Any input rate >= 16 kHz
+    censor_spans.reserve(64);
+    censor_regions.reserve(64);
+    effect_scratch.resize(4096 + CensorRenderer::kLookback);
+    wet_scratch.resize(4096);
+    ReserveDelayLine(cached_delay.load());
 }
 
 ProfanityFilter::~ProfanityFilter() {
@@ -47,6 +57,90 @@ ProfanityFilter::~ProfanityFilter() {
         stream = nullptr;
     }
     asr_model.reset();
+    
+    double mb = delay_memory_mb.load();
+    if (mb > 0) {
+        double old_total = total_delay_memory_mb.load();
+        while (!total_delay_memory_mb.compare_exchange_weak(old_total, old_total - mb));
+    }
+}
+
+// History copied into a new delay line per audio callback (all channels), ~256 KB
+static constexpr size_t kHandoverSamples = 65536;
+
+// Input samples the delay line holds beyond the delay: the output block, the effect lookback and room to
+// raise the delay (or the sample rate to change) before a resized line is in place
+static constexpr double kDelayHeadroomSeconds = 1.0;
+
+void ProfanityFilter::ReserveDelayLine(double delay) {
+    uint32_t sr = 48000;
+    size_t channels = MAX_AV_PLANES;
+    struct obs_audio_info aoi;
+    if (obs_get_audio_info(&aoi)) {
+        if (aoi.samples_per_sec) sr = aoi.samples_per_sec;
+        channels = get_audio_channels(aoi.speakers);
+    }
+    if (channels == 0) channels = MAX_AV_PLANES;
+    
+    if (resampler_rate.load() != sr) {
+        PolyphaseResampler bank; // Ends up with the retired or superseded bank, freed on return
+        bank.Configure(sr, 16000);
+        lock_guard<mutex> lock(resampler_mutex);
+        resampler_next.Swap(bank);
+        resampler_ready = true;
+        resampler_rate = sr;
+    }
+    
+    size_t capacity = DelayLine::RoundUp((size_t)((delay + kDelayHeadroomSeconds) * sr));
+    
+    lock_guard<mutex> lock(delay_mutex);
+    bool pending = delay_line_ready.load();
+    size_t have_capacity = pending ? delay_line_next.Capacity() : delay_capacity.load();
+    size_t have_channels = pending ? delay_line_next.Channels() : delay_channels.load();
+    if (capacity == have_capacity && channels == have_channels) {
+        if (!pending) delay_line_next.Release(); // Storage retired by the last swap
+    } else {
+        // Replaces the retired storage, or a pending one the audio thread has not finished taking over
+        delay_line_next.Allocate(channels, capacity);
+        delay_handover = false; // Restarts on the new storage
+        delay_line_ready = true;
+        BLOG(LOG_INFO, "Delay line of '%s': %zu samples x %zu channels (%.1f MB) for %.2f s delay",
+             obs_source_get_name(context), capacity, channels, delay_line_next.Bytes() / (1024.0 * 1024.0), delay);
+    }
+    delay_line_retired = false;
+    UpdateDelayMemory();
+}
+
+void ProfanityFilter::ReleaseRetiredDelayLine() {
+    if (!delay_line_retired.load(memory_order_acquire)) return;
+    DelayLine retired; // Freed after the lock is released
+    {
+        lock_guard<mutex> lock(delay_mutex);
+        if (!delay_line_retired.load() || delay_line_ready.load()) return;
+        retired.Swap(delay_line_next);
+        delay_line_retired = false;
+        UpdateDelayMemory(); // Now only the line in use
+    }
+}
+
+void ProfanityFilter::UpdateDelayMemory() {
+    double mb = (double)(delay_capacity.load() * delay_channels.load() * sizeof(float) + delay_line_next.Bytes()) / (1024.0 * 1024.0);
+    double diff = mb - delay_memory_mb.exchange(mb);
+    if (std::abs(diff) > 0.0) {
+        double old_total = total_delay_memory_mb.load();
+        while (!total_delay_memory_mb.compare_exchange_weak(old_total, old_total + diff));
+    }
+}
+
+void ProfanityFilter::ReserveDelayLines() {
+    double delay;
+    {
+        GlobalConfig *cfg = GetGlobalConfig();
+        lock_guard<mutex> lock(cfg->mutex);
+        delay = cfg->delay_seconds;
+    }
+    lock_guard<mutex> lock(instances_mutex);
+    for (auto *filter : instances) filter->ReserveDelayLine(delay);
 }
 
 std::pair<bool, std::string> ProfanityFilter::GetGlobalModelStatus() {
@@ -68,8 +162,53 @@ std::pair<bool, std::string> ProfanityFilter::GetGlobalModelStatus() {
     
     // Check loaded or error
     for (auto* filter : instances) {
-        if (filter->asr_model && filter->asr_model->recognizer) {
-             return {false, "🟢 模型运行中"};
+        if (filter->model_active.load()) {
+             // Worst source decides, a single overloaded source is what needs the larger delay
+             double worst = 0.0;
+             for (auto* f : instances) worst = max(worst, f->DeadlineMissRate());
+             std::string status = "🟢 模型运行中";
+             char buf[64];
+             if (worst > 0.0) {
+                 snprintf(buf, sizeof(buf), " (超时漏屏 %.1f%%)", worst * 100.0);
+                 status += buf;
+             }
+             // VAD saving over all gated sources
+             uint64_t vad_total = 0, vad_skipped = 0;
+             for (auto* f : instances) {
+                 vad_total += f->vad_samples_total.load();
+                 vad_skipped += f->vad_samples_skipped.load();
+             }
+             if (vad_total > 0) {
+                 snprintf(buf, sizeof(buf), " | 静音跳过 %.0f%%", 100.0 * (double)vad_skipped / (double)vad_total);
+                 status += buf;
+             }
+             // Private memory of the models versus their files: sherpa-onnx reads the weights into its own
+             // buffers, so every process (and every engine configuration) pays the resident size again
+             auto memory = [&](const char *label, const ModelSizes &sizes) {
+                 if (sizes.disk_bytes.load() == 0) return;
+                 snprintf(buf, sizeof(buf), " | %s %.0f/%.0f MB", label,
+                          sizes.resident_bytes.load() / (1024.0 * 1024.0), sizes.disk_bytes.load() / (1024.0 * 1024.0));
+                 status += buf;
+             };
+             memory("内存", filter->model_sizes);
+             memory("复核模型", filter->cascade_sizes);
+             // Cascade: share of audio re-decoded by the large model and the latency it added
+             uint64_t c_audio = 0, c_escalated = 0, c_windows = 0, c_latency = 0;
+             for (auto* f : instances) {
+                 c_audio += f->cascade_audio_16k.load();
+                 c_escalated += f->cascade_escalated_16k.load();
+                 c_windows += f->cascade_windows.load();
+                 c_latency += f->cascade_latency_ms.load();
+             }
+             if (c_audio > 0) {
+                 snprintf(buf, sizeof(buf), " | 复核 %.1f%%", 100.0 * (double)c_escalated / (double)c_audio);
+                 status += buf;
+                 if (c_windows > 0) {
+                     snprintf(buf, sizeof(buf), " +%.0fms", (double)c_latency / (double)c_windows);
+                     status += buf;
+                 }
+             }
+             return {false, status};
         }
         
         // Check error (initialization_error is not strictly mutex protected but only written during load)
@@ -80,31 +219,96 @@ std::pair<bool, std::string> ProfanityFilter::GetGlobalModelStatus() {
         }
     }
     
+    if (instances.empty() && preload.valid()) {
+        std::string path = preload_path;
+        if (path.length() > 40) path = "..." + path.substr(path.length() - 37);
+        if (preload.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return {true, "🟡 正在预加载 " + path};
+        }
+        const ModelLoad &load = preload.get();
+        if (!load.model) return {false, "🔴 错误: " + load.error};
+        return {false, "🟢 模型已预加载 (请添加滤镜)"};
+    }
     if (instances.empty()) return {false, "⚪ 无活跃来源 (请添加滤镜)"};
     
     return {false, "⚪ 未初始化"};
 }
 
-void ProfanityFilter::LoadModel(const string& path) {
+// Longest a loaded model waits for a segment boundary before it is swapped in mid-utterance
+static constexpr uint64_t kSwapMaxWait = 16000 * 3;
+
+// Decode settings from the config (cfg->mutex held), the fields left on auto come from the measured real-time factor
+static EngineOptions ResolveEngineOptions(const GlobalConfig &cfg) {
+    EngineOptions options;
+    options.num_threads = cfg.onnx_threads;
+    options.provider = cfg.onnx_provider;
+    options.decoding_method = cfg.decoding_method;
+    options.max_active_paths = cfg.max_active_paths;
+    options.rule1_min_trailing_silence = cfg.endpoint_rule1_ms / 1000.0f;
+    options.rule2_min_trailing_silence = cfg.endpoint_rule2_ms / 1000.0f;
+    options.prefer_int8 = cfg.prefer_int8;
+    AutoTuner::Instance().Apply(options, cfg.onnx_threads == 0, cfg.decoding_method == "auto");
+    return options;
+}
+
+void ProfanityFilter::PreloadModels() {
+    string path, cascade_path;
+    EngineMode mode;
+    EngineOptions options;
+    shared_ptr<const vector<string>> word_list;
     {
-        lock_guard<mutex> lock(history_mutex);
-        loading_target_path = path;
+        GlobalConfig *cfg = GetGlobalConfig();
+        lock_guard<mutex> lock(cfg->mutex);
+        if (!cfg->global_enable || cfg->model_path.empty()) return;
+        path = cfg->model_path;
+        cascade_path = cfg->cascade_model_path;
+        mode = (cfg->engine_mode == 1) ? EngineMode::KeywordSpotter : EngineMode::Transducer;
+        options = ResolveEngineOptions(*cfg);
+        word_list = cfg->word_list;
     }
-    is_loading = true;
-    if (stream) {
-        SherpaOnnxDestroyOnlineStream(stream);
-        stream = nullptr;
+    
+    // Same key as the filters' own request, so their first LoadAsync is a cache hit
+    BLOG(LOG_INFO, "Preloading model: %s", path.c_str());
+    auto load = ModelManager::LoadAsync(path, mode, word_list ? *word_list : vector<string>(), options);
+    if (!cascade_path.empty()) {
+        ModelManager::LoadAsync(cascade_path, EngineMode::Transducer, vector<string>(), options);
     }
     
-    if (asr_model) {
-        // If this is the last instance, the underlying model will be destroyed here
-        BLOG(LOG_INFO, "正在释放旧模型引用..."); 
+    lock_guard<mutex> lock(instances_mutex);
+    preload = load;
+    preload_path = path;
+}
+
+void ProfanityFilter::RequestModel(const string& path, EngineMode mode, const EngineOptions& options, const vector<string>& words) {
+    {
+        lock_guard<mutex> lock(history_mutex);
+        loading_target_path = path;
+        loaded_model_path = path; // Requested even if the load fails, prevents a retry loop in AsrFeed
     }
-    asr_model.reset();
+    loaded_engine_mode = mode;
+    loaded_options = options;
+    pending_load = shared_future<ModelLoad>(); // A newer request supersedes one still loading
+    {
+        // The filter holds the model from now on, the ModelManager retention decides about the preloaded one
+        lock_guard<mutex> lock(instances_mutex);
+        preload = shared_future<ModelLoad>();
+    }
+    pending_ready_seen = false;
     initialization_error = "";
     
     if (path.empty()) {
-        loaded_model_path = "";
+        // Unloading is immediate, nothing is decoded either way
+        is_loading = false;
+        if (stream) {
+            SherpaOnnxDestroyOnlineStream(stream);
+            stream = nullptr;
+        }
+        if (asr_model) {
+            // If this is the last instance, the underlying model will be destroyed here
+            BLOG(LOG_INFO, "正在释放旧模型引用..."); 
+        }
+        asr_model.reset();
+        PublishModelState();
         
         // Check if it's due to global disable
         GlobalConfig *cfg = GetGlobalConfig();
@@ -120,61 +324,219 @@ void ProfanityFilter::LoadModel(const string& path) {
         } else {
             // Just unloaded, no error
         }
-        is_loading = false;
         return;
     }
     
-    string err;
-    asr_model = ModelManager::Get(path, err);
+    is_loading = true;
+    pending_load = ModelManager::LoadAsync(path, mode, words, options);
+    if (asr_model) {
+        BLOG(LOG_INFO, "后台加载模型, 切换前继续使用当前模型: %s", path.c_str());
+    }
+}
+
+void ProfanityFilter::AsrPollModelLoad(const vector<string>& words, uint64_t words_generation, float hotword_score) {
+    if (!pending_load.valid() || pending_load.wait_for(chrono::seconds(0)) != future_status::ready) return;
     
-    if (asr_model && asr_model->recognizer) {
-        stream = SherpaOnnxCreateOnlineStream(asr_model->recognizer);
-        {
-            lock_guard<mutex> lock(history_mutex);
-            loaded_model_path = path;
+    bool have_old = asr_model && asr_model->IsValid() && stream;
+    if (!pending_ready_seen) {
+        pending_ready_seen = true;
+        pending_ready_16k = total_samples_popped_16k;
+    }
+    // Swapping mid-utterance would split a word between two models; a speaker who never pauses forces it
+    if (have_old && !at_segment_boundary && total_samples_popped_16k - pending_ready_16k < kSwapMaxWait) return;
+    
+    ModelLoad load = pending_load.get();
+    pending_load = shared_future<ModelLoad>();
+    is_loading = false;
+    
+    if (!load.model) {
+        initialization_error = load.error;
+        BLOG(LOG_ERROR, "错误: %s%s", initialization_error.c_str(), have_old ? " (继续使用当前模型)" : "");
+        return;
+    }
+    
+    size_t skipped = 0;
+    const SherpaOnnxOnlineStream *new_stream = load.model->CreateStreamFor(words, hotword_score, &skipped);
+    if (load.model->recognizer && hotword_score > 0.0f) {
+        BLOG(LOG_INFO, "Hotwords: %zu words biased (score %.1f), %zu not in model vocabulary", words.size() - skipped, hotword_score, skipped);
+    }
+    
+    // Replay what the new stream needs to carry on: nothing at a boundary, otherwise the current segment
+    // (or, without a previous model, everything not yet played out) as far as the history reaches
+    uint64_t now = min(total_samples_popped_16k, model_history.End());
+    uint64_t replay_start = now;
+    if (!(have_old && at_segment_boundary)) {
+        uint64_t unplayed = (uint64_t)(cached_delay.load(memory_order_relaxed) * 16000.0);
+        replay_start = max<uint64_t>((now > unplayed) ? now - unplayed : 0, model_history.Oldest());
+        if (have_old) replay_start = max(replay_start, last_reset_sample_16k);
+        replay_start = min(replay_start, now);
+    }
+    if (replay_start < now) {
+        vector<float> replay;
+        model_history.Read(replay_start, now, replay);
+        SherpaOnnxOnlineStreamAcceptWaveform(new_stream, 16000, replay.data(), (int32_t)replay.size());
+    }
+    replay_end_16k = have_old ? now : 0;
+    
+    if (stream) SherpaOnnxDestroyOnlineStream(stream);
+    if (asr_model) {
+        // If this is the last instance, the underlying model will be destroyed here
+        BLOG(LOG_INFO, "正在释放旧模型引用..."); 
+    }
+    asr_model = load.model;
+    PublishModelState();
+    stream = new_stream;
+    stream_words_generation = words_generation;
+    stream_hotword_score = hotword_score;
+    last_reset_sample_16k = replay_start;
+    ResetMatchCursor();
+    {
+        lock_guard<mutex> lock(history_mutex);
+        current_partial_text = "";
+    }
+    BLOG(LOG_INFO, "引擎初始化成功 (回放 %.1f s%s)", (double)(now - replay_start) / 16000.0,
+        (have_old && !at_segment_boundary) ? ", 未等到停顿" : "");
+}
+
+// Longest region whose replacement audio is pre-rendered, longer ones are rendered at playout
+static constexpr double kMaxSegmentSeconds = 10.0;
+
+ProfanityFilter::BeepRange ProfanityFilter::PrepareBeep(uint64_t start_abs, uint64_t end_abs) {
+    BeepRange beep{start_abs, end_abs, start_abs};
+    uint32_t sr = sample_rate.load();
+    if (!segment_renderer.Precomputable() || end_abs <= start_abs) return beep;
+    
+    // Covers the edge fades as well
+    size_t ramp = segment_renderer.RampSamples();
+    uint64_t segment_start = (start_abs > ramp) ? start_abs - ramp : 0;
+    size_t length = (size_t)(end_abs + ramp - segment_start);
+    if (length > (size_t)(kMaxSegmentSeconds * sr)) return beep;
+    
+    int index;
+    {
+        lock_guard<mutex> lock(beep_mutex);
+        if (free_segments.empty()) {
+            segment_pool.emplace_back();
+            free_segments.reserve(segment_pool.size()); // Every segment can be handed back without allocating
+            index = (int)segment_pool.size() - 1;
+        } else {
+            index = free_segments.back();
+            free_segments.pop_back();
         }
-        BLOG(LOG_INFO, "引擎初始化成功");
-    } else {
-        initialization_error = err.empty() ? "引擎初始化失败" : err;
-        BLOG(LOG_ERROR, "错误: %s", initialization_error.c_str());
-        
-        // IMPORTANT: Even if failed, update loaded_model_path to prevent infinite retry loop in ASRLoop
-        {
-            lock_guard<mutex> lock(history_mutex);
-            loaded_model_path = path;
+    }
+    // Owned by this beep until the audio thread hands it back, so it is filled without the lock
+    vector<float> &segment = segment_pool[index];
+    segment.resize(length); // Reused segments keep their capacity
+    segment_renderer.RenderWet(segment.data(), length, segment_start);
+    beep.segment = index;
+    beep.segment_start = segment_start;
+    beep.signature = segment_renderer.Signature();
+    return beep;
+}
+
+bool ProfanityFilter::QueueBeep(uint64_t start_abs, uint64_t end_abs, uint64_t start_16k, uint64_t *id) {
+    BeepRange beep = PrepareBeep(start_abs, end_abs);
+    lock_guard<mutex> b_lock(beep_mutex);
+    if (start_16k < replay_end_16k) {
+        // Heard again in the replayed tail after a model swap
+        for (const auto &b : pending_beeps) {
+            if (start_abs < b.end_sample && end_abs > b.original_start) {
+                if (beep.segment >= 0) free_segments.push_back(beep.segment);
+                return false;
+            }
         }
     }
-    is_loading = false;
+    if (id) {
+        beep.id = ++next_beep_id;
+        *id = beep.id;
+    }
+    pending_beeps.push_back(beep);
+    return true;
+}
+
+bool ProfanityFilter::CancelBeep(uint64_t id) {
+    lock_guard<mutex> b_lock(beep_mutex);
+    for (auto &b : pending_beeps) {
+        if (b.id != id) continue;
+        if (b.started) return false;
+        // The audio thread drops it and hands its segment back (it may be reading segments right now)
+        b.cancelled = true;
+        return true;
+    }
+    return false;
+}
+
+bool ProfanityFilter::ExtendBeep(uint64_t id, uint64_t start_abs, uint64_t end_abs) {
+    auto find = [&]() -> BeepRange * {
+        for (auto &b : pending_beeps) {
+            if (b.id == id) return (b.started || b.cancelled) ? nullptr : &b;
+        }
+        return nullptr;
+    };
+    uint64_t from, to;
+    {
+        lock_guard<mutex> b_lock(beep_mutex);
+        BeepRange *b = find();
+        if (!b || end_abs <= b->start_sample || start_abs >= b->end_sample) return false;
+        if (start_abs >= b->start_sample && end_abs <= b->end_sample) return true; // Already covered
+        from = min(start_abs, b->start_sample);
+        to = max(end_abs, b->end_sample);
+    }
+    // Rendered for the union, then swapped in unless the beep started playing meanwhile
+    BeepRange wider = PrepareBeep(from, to);
+    lock_guard<mutex> b_lock(beep_mutex);
+    BeepRange *b = find();
+    if (!b) {
+        if (wider.segment >= 0) free_segments.push_back(wider.segment);
+        return false;
+    }
+    // Not started, so the audio thread never read its segment
+    if (b->segment >= 0) free_segments.push_back(b->segment);
+    b->start_sample = wider.start_sample;
+    b->end_sample = wider.end_sample;
+    b->original_start = min(b->original_start, wider.original_start);
+    b->segment = wider.segment;
+    b->segment_start = wider.segment_start;
+    b->signature = wider.signature;
+    return true;
+}
+
+void ProfanityFilter::PublishModelState() {
+    model_active = asr_model && asr_model->IsValid();
+    auto publish = [](ModelSizes &sizes, const ModelHandle &model) {
+        sizes.resident_bytes = model ? (uint64_t)model->resident_bytes : 0;
+        sizes.disk_bytes = model ? (uint64_t)model->disk_bytes : 0;
+    };
+    publish(model_sizes, asr_model);
+    publish(cascade_sizes, cascade_model);
+}
+
+void ProfanityFilter::ResetMatchCursor() {
+    match_cursor.stable_tokens = 0;
+    match_cursor.reported.clear();
+    match_cursor.escalated.clear();
 }
 
 void ProfanityFilter::Start() {
     if (running) return;
     running = true;
-    asr_thread = thread(&ProfanityFilter::ASRLoop, this);
+    AsrInitTimeSync();
+    ASRWorkerPool::Instance().Register(this);
 }
 
 void ProfanityFilter::Stop() {
+    if (!running) return;
     running = false;
-    if (asr_thread.joinable()) asr_thread.join();
+    ASRWorkerPool::Instance().Unregister(this); // Waits for an in-flight batch
 }
 
-void ProfanityFilter::ASRLoop() {
-    uint64_t total_samples_popped_16k = 0;
-    
-    // Time sync
-    uint64_t start_offset_input = 0;
-    uint64_t last_feed_offset = 0;
-    
-    // AGC State
-    float current_agc_gain = 1.0f;
+void ProfanityFilter::AsrInitTimeSync() {
+    // Overflow tracking (ring drops blocks when ASR falls behind)
+    seen_overflow_events = asr_ring.OverflowEvents();
     
     uint64_t tw = total_samples_written.load();
     if (tw > 0) {
-        size_t q_size;
-        {
-            lock_guard<mutex> lock(queue_mutex);
-            q_size = asr_queue.size();
-        }
+        size_t q_size = asr_ring.Size();
         double ratio = sample_rate_ratio.load();
         uint64_t backlog_input = (uint64_t)(q_size * ratio);
         if (tw > backlog_input) {
@@ -182,493 +544,738 @@ void ProfanityFilter::ASRLoop() {
         }
         last_feed_offset = start_offset_input;
     }
+}
 
-    while (running) {
-        // Poll Global Config for model path changes and Gain settings
-        bool enable_agc = true;
+bool ProfanityFilter::AsrDue(chrono::steady_clock::duration since_last_service) const {
+    size_t wake = asr_wake_samples.load(memory_order_relaxed);
+    // Twice the chunk length without a full chunk: take the partial audio and re-check model/config
+    auto timeout = chrono::milliseconds((int64_t)(wake / 16) * 2);
+    return asr_ring.Size() >= wake || since_last_service >= timeout;
+}
+
+double ProfanityFilter::AsrSlackMs() const {
+    // Queued audio arrived backlog ms ago and plays out delay ms after arrival
+    double backlog_ms = (double)asr_ring.Size() / 16.0;
+    return cached_delay.load(memory_order_relaxed) * 1000.0 - backlog_ms;
+}
+
+double ProfanityFilter::VadSkipRate() const {
+    uint64_t total = vad_samples_total.load();
+    return total ? (double)vad_samples_skipped.load() / (double)total : 0.0;
+}
+
+double ProfanityFilter::DeadlineMissRate() const {
+    uint64_t total = beeps_scheduled.load();
+    return total ? (double)deadline_misses.load() / (double)total : 0.0;
+}
+
+bool ProfanityFilter::AsrFeed() {
+    ReleaseRetiredDelayLine(); // Not on the audio thread, which retired it
+    if (sample_rate.load() != resampler_rate.load()) {
+        ReserveDelayLine(cached_delay.load()); // OBS audio rate changed: new filter bank and delay line
+    }
+    
+    // Poll Global Config for model path changes and Gain settings
+    bool enable_agc = true;
+    bool enable_vad = false;
+    int min_chunk_ms = 100;
+    shared_ptr<const vector<string>> word_list;
+    uint64_t words_generation = 0;
+    float hotword_score = 0.0f;
+    
+    {
+        GlobalConfig *cfg = GetGlobalConfig();
+        std::lock_guard<std::mutex> lock(cfg->mutex);
         
-        {
-            GlobalConfig *cfg = GetGlobalConfig();
-            std::lock_guard<std::mutex> lock(cfg->mutex);
+        // Only the ASR side touches target_model_path, the audio thread never takes this path
+        target_model_path = cfg->global_enable ? cfg->model_path : "";
+        target_engine_mode = (cfg->engine_mode == 1) ? EngineMode::KeywordSpotter : EngineMode::Transducer;
+        target_cascade_path = cfg->global_enable ? cfg->cascade_model_path : "";
+        word_list = cfg->word_list;
+        words_generation = cfg->words_generation;
+        hotword_score = (float)cfg->hotword_score;
+        
+        target_options = ResolveEngineOptions(*cfg);
+        // Effect settings for PrepareBeep, so a beep never waits on the config lock
+        segment_renderer.Configure(sample_rate.load(), cfg->audio_effect, cfg->beep_frequency, cfg->beep_mix_percent);
+        enable_agc = cfg->enable_agc;
+        enable_vad = cfg->enable_vad;
+        min_chunk_ms = cfg->asr_min_chunk_ms;
+    }
+
+    // 1. Check for Model Change or Ring Overflow
+    {
+        bool model_changed = target_model_path != loaded_model_path || target_engine_mode != loaded_engine_mode ||
+                             (!target_model_path.empty() && target_options != loaded_options);
+        uint64_t overflow_events = asr_ring.OverflowEvents();
+        bool overflowed = overflow_events != seen_overflow_events;
+        
+        if (overflowed) {
+            seen_overflow_events = overflow_events;
+            BLOG(LOG_WARNING, "ASR fell behind, audio ring overflowed (%llu samples dropped in total). Resyncing.",
+                (unsigned long long)asr_ring.OverflowSamples());
+        }
+        
+        if (model_changed) {
+            // The current model keeps decoding until the new one is loaded, no audio is dropped
+            RequestModel(target_model_path, target_engine_mode, target_options, word_list ? *word_list : vector<string>());
+        }
+        
+        if (overflowed) {
+            if (asr_model && asr_model->IsValid() && stream) {
+                // Dropped audio breaks stream continuity, start a fresh segment
+                asr_model->ResetStream(stream);
+                {
+                    lock_guard<mutex> h_lock(history_mutex);
+                    current_partial_text = "";
+                }
+            }
+            // Reset stream implies resetting timestamp reference
+            last_reset_sample_16k = total_samples_popped_16k;
+            at_segment_boundary = true;
+
+            // Fix: Drain ring and clear processed matches to prevent latency accumulation and index collision
+            asr_ring.Clear();
+            
+            // Re-sync time after clearing queue
+            uint64_t tw_now = total_samples_written.load();
+            double ratio_now = sample_rate_ratio.load();
+            int64_t diff = (int64_t)tw_now - (int64_t)(total_samples_popped_16k * ratio_now);
+            if (diff >= 0) {
+                start_offset_input = (uint64_t)diff;
+            }
+            last_feed_offset = start_offset_input;
             
-            std::string desired_path = cfg->global_enable ? cfg->model_path : "";
-            enable_agc = cfg->enable_agc;
+            ResetMatchCursor();
+            escalations.clear(); // Their 16k -> input mapping changed
+        }
+    }
+    AsrPollModelLoad(word_list ? *word_list : vector<string>(), words_generation, hotword_score);
+
+    // Cascade: second-tier model (shared through ModelManager like the first tier, loaded in the background too)
+    if (target_cascade_path != loaded_cascade_path || (cascade_model && cascade_model->options != target_options)) {
+        loaded_cascade_path = target_cascade_path;
+        pending_cascade_load = shared_future<ModelLoad>();
+        if (target_cascade_path.empty()) {
+            cascade_model.reset();
+            cascade_verifier.reset();
+            escalations.clear();
+            PublishModelState();
+        } else {
+            pending_cascade_load = ModelManager::LoadAsync(target_cascade_path, EngineMode::Transducer, vector<string>(), target_options);
+        }
+    }
+    if (pending_cascade_load.valid() && pending_cascade_load.wait_for(chrono::seconds(0)) == future_status::ready) {
+        // Escalations only refer to the shared history, they carry over to the new second tier
+        ModelLoad load = pending_cascade_load.get();
+        pending_cascade_load = shared_future<ModelLoad>();
+        if (load.model) {
+            cascade_model = load.model;
+            BLOG(LOG_INFO, "Cascade enabled, verifying suspicious windows with: %s", loaded_cascade_path.c_str());
+        } else {
+            BLOG(LOG_ERROR, "Cascade model failed to load (%s): %s", loaded_cascade_path.c_str(), load.error.c_str());
+            cascade_model.reset();
+            escalations.clear();
+        }
+        if (cascade_model && !cascade_verifier) cascade_verifier = make_unique<CascadeVerifier>();
+        if (!cascade_model) cascade_verifier.reset();
+        PublishModelState();
+    }
+
+    // Keywords (KWS) and hotwords (transducer) are part of the stream, rebuild it when the word list changes
+    bool bias_changed = words_generation != stream_words_generation ||
+                        (asr_model && asr_model->recognizer && hotword_score != stream_hotword_score);
+    if (asr_model && asr_model->IsValid() && stream && word_list && bias_changed) {
+        SherpaOnnxDestroyOnlineStream(stream);
+        stream = asr_model->CreateStreamFor(*word_list, hotword_score);
+        stream_words_generation = words_generation;
+        stream_hotword_score = hotword_score;
+        last_reset_sample_16k = total_samples_popped_16k;
+        ResetMatchCursor();
+    }
+    
+    // 2. Process Audio
+    // The pool services this filter once a full chunk is queued (or the wait times out, then any partial audio is taken)
+    size_t min_chunk = (size_t)min_chunk_ms * 16;
+    asr_wake_samples.store(min_chunk, memory_order_relaxed);
+
+    double current_ratio = sample_rate_ratio.load();
+    uint32_t current_sr = sample_rate.load();
+
+    vector<float> &chunk = asr_chunk;
+    chunk.resize(max<size_t>(min_chunk, 3200));
+    size_t popped = asr_ring.Read(chunk.data(), chunk.size());
+    chunk.resize(popped);
+    if (popped > 0) {
+        // Gap Check: If start_offset_input jumped significantly (e.g. > 0.5s), reset stream
+        // This handles cases where filter was disabled/idle for a long time, ensuring fresh context
+        // and preventing latency accumulation from stale state.
+        if (start_offset_input > last_feed_offset + (uint64_t)(current_sr * 0.5)) {
+                if (asr_model && asr_model->IsValid() && stream) {
+                    SherpaOnnxDestroyOnlineStream(stream);
+                    stream = asr_model->CreateStreamFor(word_list ? *word_list : vector<string>(), hotword_score);
+                    stream_words_generation = words_generation;
+                    stream_hotword_score = hotword_score;
+                    last_reset_sample_16k = total_samples_popped_16k;
+                    ResetMatchCursor();
+                    {
+                        lock_guard<mutex> h_lock(history_mutex);
+                        current_partial_text = "";
+                    }
+                }
+        }
+        last_feed_offset = start_offset_input;
+    } else {
+        // Re-sync offset to handle gaps (e.g. toggle enabled, queue clear)
+        // This ensures timestamps remain accurate even if we dropped samples
+        uint64_t tw = total_samples_written.load();
+        if (tw > 0) {
+            // Calculate what start_offset_input SHOULD be so that:
+            // current_time ~= start_offset + total_popped * ratio
+            // We assume since queue is empty, current_time == tw
             
-            if (target_model_path != desired_path) {
-                std::lock_guard<std::mutex> q_lock(queue_mutex);
-                target_model_path = desired_path;
+            // Use signed math to handle potential small drift
+            int64_t diff = (int64_t)tw - (int64_t)(total_samples_popped_16k * current_ratio);
+            // start_offset_input is uint64, assuming positive result
+            if (diff >= 0) {
+                start_offset_input = (uint64_t)diff;
             }
         }
+    }
 
-        // 1. Check for Model Change
-        {
-            string target;
+    if (chunk.empty()) return false;
+    
+    total_samples_popped_16k += chunk.size();
+    
+    // --- Gain Processing (AGC) ---
+    // Create a copy for model processing so output audio remains original
+    vector<float> model_chunk = chunk;
+    
+    if (enable_agc) {
+        // Automatic Gain Control
+        float peak = 0.0001f;
+        for (float s : model_chunk) {
+            float abs_s = fabsf(s);
+            if (abs_s > peak) peak = abs_s;
+        }
+        
+        // Target Peak: 0.6 (-4.4 dB)
+        float target_peak = 0.6f;
+        float desired_gain = target_peak / peak;
+        
+        // Constraints
+        if (desired_gain > 31.6f) desired_gain = 31.6f; // Max +30dB
+        if (desired_gain < 0.1f) desired_gain = 0.1f;   // Min -20dB
+        
+        // Smooth Update
+        if (desired_gain < current_agc_gain) {
+            // Attack (fast reduction)
+            current_agc_gain = current_agc_gain * 0.9f + desired_gain * 0.1f;
+        } else {
+            // Release (slow increase)
+            current_agc_gain = current_agc_gain * 0.99f + desired_gain * 0.01f;
+        }
+        
+        // Apply to model_chunk ONLY
+        for (float &s : model_chunk) {
+            s *= current_agc_gain;
+            if (s > 1.0f) s = 1.0f;
+            if (s < -1.0f) s = -1.0f;
+        }
+    } else {
+         current_agc_gain = 1.0f; // Reset if disabled
+    }
+    // ---------------------------------------
+
+    // History holds what the first tier heard, gated or not (escalation windows and swap replays may span a gap)
+    model_history.Append(model_chunk.data(), model_chunk.size(), total_samples_popped_16k);
+    if (cascade_verifier) cascade_audio_16k.fetch_add(model_chunk.size());
+
+    // --- Voice Activity Gating ---
+    if (!enable_vad) {
+        voice_gate.reset();
+        voice_gate_failed = false;
+    } else if (!voice_gate && !voice_gate_failed) {
+        voice_gate = VoiceGate::Create();
+        voice_gate_failed = !voice_gate;
+    }
+
+    if (voice_gate && asr_model && asr_model->IsValid() && stream) {
+        uint64_t total = vad_samples_total.fetch_add(model_chunk.size()) + model_chunk.size();
+        VoiceGate::Decision decision = voice_gate->Process(model_chunk.data(), model_chunk.size());
+        if (decision == VoiceGate::Decision::Skip) {
+            vad_samples_skipped.fetch_add(model_chunk.size());
+        } else if (decision == VoiceGate::Decision::Onset) {
+            // The stream has not seen the gated gap: start a fresh segment at the pre-roll so that
+            // stream time 0 is an exact 16k sample index again (timestamps stay absolute)
+            const vector<float> &preroll = voice_gate->PreRoll();
+            asr_model->ResetStream(stream);
+            last_reset_sample_16k = total_samples_popped_16k - model_chunk.size() - preroll.size();
+            ResetMatchCursor();
             {
-                lock_guard<mutex> lock(queue_mutex);
-                target = target_model_path;
+                lock_guard<mutex> h_lock(history_mutex);
+                current_partial_text = "";
             }
-            
-            if (target != loaded_model_path) {
-                LoadModel(target);
-                // Reset stream implies resetting timestamp reference
-                last_reset_sample_16k = total_samples_popped_16k;
+            if (!preroll.empty()) {
+                SherpaOnnxOnlineStreamAcceptWaveform(stream, 16000, preroll.data(), (int32_t)preroll.size());
+                vad_samples_skipped.fetch_sub(preroll.size()); // Pre-roll was counted as skipped, it is decoded after all
+            }
+        }
 
-                // Fix: Clear queue and processed matches to prevent latency accumulation and index collision
-                {
-                    lock_guard<mutex> lock(queue_mutex);
-                    asr_queue.clear();
-                }
-                
-                // Re-sync time after clearing queue
-                uint64_t tw_now = total_samples_written.load();
-                double ratio_now = sample_rate_ratio.load();
-                int64_t diff = (int64_t)tw_now - (int64_t)(total_samples_popped_16k * ratio_now);
-                if (diff >= 0) {
-                    start_offset_input = (uint64_t)diff;
+        // Report the saving every 5 minutes of audio
+        const uint64_t report_every = 16000 * 300;
+        if (total / report_every != (total - model_chunk.size()) / report_every) {
+            BLOG(LOG_INFO, "VAD on '%s': %.1f%% of audio skipped", obs_source_get_name(context), VadSkipRate() * 100.0);
+        }
+        if (decision == VoiceGate::Decision::Skip) {
+            at_segment_boundary = true;
+            return false;
+        }
+    }
+    // ---------------------------------------
+
+    if (asr_model && asr_model->IsValid() && stream) {
+        SherpaOnnxOnlineStreamAcceptWaveform(stream, 16000, model_chunk.data(), (int32_t)model_chunk.size());
+        at_segment_boundary = false;
+        chunk_ratio = current_ratio;
+        chunk_sr = current_sr;
+        return true;
+    }
+    return false;
+}
+
+void ProfanityFilter::StreamTimeToInput(uint64_t base_16k, float start_time, float end_time, int model_offset_ms, uint64_t &start_abs, uint64_t &end_abs) const {
+    double current_ratio = chunk_ratio;
+    uint32_t current_sr = chunk_sr;
+
+    uint64_t start_16k = base_16k + (uint64_t)(start_time * 16000.0f);
+    uint64_t end_16k = base_16k + (uint64_t)(end_time * 16000.0f);
+    
+    start_abs = (uint64_t)(start_16k * current_ratio) + start_offset_input;
+    end_abs = (uint64_t)(end_16k * current_ratio) + start_offset_input;
+    
+    // Apply Model Latency Offset
+    int64_t offset_samples = (int64_t)((model_offset_ms / 1000.0) * current_sr);
+    if (offset_samples >= 0) {
+        start_abs += offset_samples;
+        end_abs += offset_samples;
+    } else {
+        uint64_t sub = (uint64_t)(-offset_samples);
+        start_abs = (start_abs > sub) ? start_abs - sub : 0;
+        end_abs = (end_abs > sub) ? end_abs - sub : 0;
+    }
+    
+    // Safe margin: 150ms = 0.15 * sr (Reduced from 400ms to avoid false positives)
+    uint32_t margin = (uint32_t)(0.15 * current_sr);
+    start_abs = (start_abs > margin) ? start_abs - margin : 0; 
+    end_abs += margin; 
+}
+
+void ProfanityFilter::AsrHandleKeywordResult() {
+    // The spotter reports one keyword at a time; the beep path is the same as for recognized text
+    int model_offset_ms;
+    {
+        GlobalConfig *cfg = GetGlobalConfig();
+        lock_guard<mutex> lock(cfg->mutex);
+        model_offset_ms = cfg->model_offset_ms;
+    }
+
+    const SherpaOnnxKeywordResult *result = SherpaOnnxGetKeywordResult(asr_model->keyword_spotter, stream);
+    bool detected = false;
+    if (result) {
+        if (result->keyword && result->keyword[0] && result->count > 0) {
+            float start_time = result->timestamps[0];
+            float end_time = result->timestamps[result->count - 1] + 0.2f;
+
+            uint64_t start_abs, end_abs;
+            StreamTimeToInput(last_reset_sample_16k, start_time, end_time, model_offset_ms, start_abs, end_abs);
+            uint64_t start_16k = last_reset_sample_16k + (uint64_t)(start_time * 16000.0f);
+            uint64_t beep_id = 0;
+            if (QueueBeep(start_abs, end_abs, start_16k, cascade_model ? &beep_id : nullptr)) {
+                BLOG(LOG_INFO, "已屏蔽(KWS): %s", result->keyword);
+                // Cascade: censored at once, the large model can still withdraw it before playout
+                if (cascade_model) {
+                    Escalate(start_16k, last_reset_sample_16k + (uint64_t)(end_time * 16000.0f), beep_id, result->keyword);
                 }
-                last_feed_offset = start_offset_input;
-                
-                processed_matches.clear();
             }
+            {
+                lock_guard<mutex> lock(history_mutex);
+                current_partial_text = result->keyword;
+            }
+            detected = true;
         }
-        
-        // 2. Process Audio
-        vector<float> chunk;
-        double current_ratio = sample_rate_ratio.load();
-        uint32_t current_sr = sample_rate.load();
+        SherpaOnnxDestroyKeywordResult(result);
+    }
 
-        {
-            lock_guard<mutex> lock(queue_mutex);
-            if (!asr_queue.empty()) {
-                // Gap Check: If start_offset_input jumped significantly (e.g. > 0.5s), reset stream
-                // This handles cases where filter was disabled/idle for a long time, ensuring fresh context
-                // and preventing latency accumulation from stale state.
-                if (start_offset_input > last_feed_offset + (uint64_t)(current_sr * 0.5)) {
-                        if (asr_model && asr_model->recognizer && stream) {
-                            SherpaOnnxDestroyOnlineStream(stream);
-                            stream = SherpaOnnxCreateOnlineStream(asr_model->recognizer);
-                            last_reset_sample_16k = total_samples_popped_16k;
-                            processed_matches.clear();
-                            {
-                                lock_guard<mutex> h_lock(history_mutex);
-                                current_partial_text = "";
-                            }
-                        }
-                }
-                last_feed_offset = start_offset_input;
+    // Timestamps are relative to the last reset, so restart after every hit (and on very long segments)
+    bool force_reset = (total_samples_popped_16k - last_reset_sample_16k) > (16000 * 600);
+    if (detected || force_reset) {
+        asr_model->ResetStream(stream);
+        last_reset_sample_16k = total_samples_popped_16k;
+        at_segment_boundary = true;
+    }
+}
+
+// Cascade window around a suspicious span: context for the large model, and time for the word to finish
+static constexpr uint64_t kCascadeContext = 16000;          // 1 s before the span
+static constexpr uint64_t kCascadeLookahead = 16000 / 2;    // 0.5 s after it
+static constexpr uint64_t kCascadeMaxWindow = 16000 * 6;
+static constexpr uint64_t kCascadeSpanSlack = 16000 * 3 / 10; // Second-tier matches may sit slightly off the span
 
-                size_t n = min((size_t)3200, asr_queue.size()); 
-                chunk.assign(asr_queue.begin(), asr_queue.begin() + n);
-                asr_queue.erase(asr_queue.begin(), asr_queue.begin() + n);
+double ProfanityFilter::CascadeSlackMs(uint64_t span_start_16k) const {
+    double sr = (double)chunk_sr;
+    double span_input = (double)span_start_16k * chunk_ratio + (double)start_offset_input;
+    double play_head = (double)total_samples_written.load() - cached_delay.load(memory_order_relaxed) * sr;
+    return (span_input - play_head) * 1000.0 / sr;
+}
+
+void ProfanityFilter::Escalate(uint64_t span_start_16k, uint64_t span_end_16k, uint64_t beep_id, const string &text) {
+    // Budget: the window needs its lookahead to arrive (in real time) and then one decode
+    uint64_t win_end = span_end_16k + kCascadeLookahead;
+    double wait_ms = (win_end > total_samples_popped_16k) ? (double)(win_end - total_samples_popped_16k) / 16.0 : 0.0;
+    double slack_ms = CascadeSlackMs(span_start_16k);
+    if (slack_ms - wait_ms <= cascade_decode_ms) {
+        cascade_timeouts++;
+        if (beep_id) {
+            BLOG(LOG_INFO, "已屏蔽(未复核): %s", text.c_str());
+        } else {
+            BLOG(LOG_INFO, "Cascade skipped '%s': %.0f ms left, window needs ~%.0f ms", text.c_str(), slack_ms, wait_ms + cascade_decode_ms);
+        }
+        return;
+    }
+    escalations.push_back({span_start_16k, span_end_16k, beep_id, chrono::steady_clock::now(), text});
+}
+
+void ProfanityFilter::AsrRunEscalations() {
+    if (escalations.empty()) return;
+
+    GlobalConfig *cfg = GetGlobalConfig();
+    shared_ptr<const WordMatcher> matcher;
+    bool use_pinyin;
+    int model_offset_ms;
+    {
+        lock_guard<mutex> lock(cfg->mutex);
+        matcher = cfg->word_matcher;
+        use_pinyin = cfg->use_pinyin;
+        model_offset_ms = cfg->model_offset_ms;
+    }
+    shared_ptr<const PinyinMatcher> pinyin_matcher = use_pinyin ? SharedPinyinMatcher::Instance().Get() : nullptr;
+
+    size_t done = 0;
+    for (; done < escalations.size(); done++) {
+        const Escalation &esc = escalations[done];
+        uint64_t win_end = esc.span_end_16k + kCascadeLookahead;
+        if (win_end > total_samples_popped_16k) break; // Still waiting for audio (escalations are roughly in time order)
+        uint64_t win_start = (esc.span_start_16k > kCascadeContext) ? esc.span_start_16k - kCascadeContext : 0;
+        if (win_end - win_start > kCascadeMaxWindow) win_start = win_end - kCascadeMaxWindow;
+
+        // Checked again before decoding, the estimate in Escalate may have been optimistic
+        double slack_ms = CascadeSlackMs(esc.span_start_16k);
+
+        auto decode_start = chrono::steady_clock::now();
+        const SherpaOnnxOnlineRecognizerResult *result = nullptr;
+        if (cascade_model && cascade_verifier && slack_ms > cascade_decode_ms) {
+            result = cascade_verifier->Decode(*cascade_model, model_history, win_start, win_end);
+        }
+        if (!result) {
+            cascade_timeouts++;
+            if (esc.beep_id) {
+                BLOG(LOG_INFO, "已屏蔽(未复核): %s", esc.text.c_str()); // The spotter's beep stays
             } else {
-                // Re-sync offset to handle gaps (e.g. toggle enabled, queue clear)
-                // This ensures timestamps remain accurate even if we dropped samples
-                uint64_t tw = total_samples_written.load();
-                if (tw > 0) {
-                    // Calculate what start_offset_input SHOULD be so that:
-                    // current_time ~= start_offset + total_popped * ratio
-                    // We assume since queue is empty, current_time == tw
-                    
-                    // Use signed math to handle potential small drift
-                    int64_t diff = (int64_t)tw - (int64_t)(total_samples_popped_16k * current_ratio);
-                    // start_offset_input is uint64, assuming positive result
-                    if (diff >= 0) {
-                        start_offset_input = (uint64_t)diff;
-                    }
+                BLOG(LOG_INFO, "Cascade skipped '%s': %.0f ms left, decode needs ~%.0f ms", esc.text.c_str(), slack_ms, cascade_decode_ms);
+            }
+            continue;
+        }
+        auto decode_end = chrono::steady_clock::now();
+        cascade_decode_ms = cascade_decode_ms * 0.8 + chrono::duration<double, milli>(decode_end - decode_start).count() * 0.2;
+
+        // Only matches on the escalated span count, the rest of the window is context the first tier already handled
+        bool confirmed = false;
+        size_t count = (size_t)result->count;
+        MatchTokens(result, 0, matcher.get(), pinyin_matcher.get(), cascade_model->pinyin_table.get(),
+            [&](size_t start_token, size_t end_token, string log_text, bool) {
+                float start_time = result->timestamps[start_token];
+                float end_time = (end_token + 1 < count) ? result->timestamps[end_token+1] : (result->timestamps[end_token] + 0.2f);
+                uint64_t start_16k = win_start + (uint64_t)(start_time * 16000.0f);
+                uint64_t end_16k = win_start + (uint64_t)(end_time * 16000.0f);
+                if (end_16k + kCascadeSpanSlack < esc.span_start_16k || start_16k > esc.span_end_16k + kCascadeSpanSlack) return;
+                
+                uint64_t start_abs, end_abs;
+                StreamTimeToInput(win_start, start_time, end_time, model_offset_ms, start_abs, end_abs);
+                // Same word as the spotter's beep: that one is widened if needed, otherwise a beep of its own
+                if (!(esc.beep_id && ExtendBeep(esc.beep_id, start_abs, end_abs))) {
+                    QueueBeep(start_abs, end_abs, start_16k);
                 }
+                BLOG(LOG_INFO, "%s (复核, 初判: %s)", log_text.c_str(), esc.text.c_str());
+                confirmed = true;
+            });
+        SherpaOnnxDestroyOnlineRecognizerResult(result);
+        if (!confirmed) {
+            if (esc.beep_id && CancelBeep(esc.beep_id)) {
+                BLOG(LOG_INFO, "复核未确认, 已撤销屏蔽: %s", esc.text.c_str());
+            } else {
+                BLOG(LOG_INFO, "复核未确认: %s", esc.text.c_str());
             }
         }
-        
-        if (chunk.empty()) {
-            this_thread::sleep_for(chrono::milliseconds(10));
-            continue;
+
+        uint64_t windows = ++cascade_windows;
+        uint64_t escalated = cascade_escalated_16k.fetch_add(win_end - win_start) + (win_end - win_start);
+        uint64_t latency = cascade_latency_ms.fetch_add((uint64_t)chrono::duration<double, milli>(decode_end - esc.created).count());
+        if (windows % 50 == 0) {
+            BLOG(LOG_INFO, "Cascade on '%s': %llu windows, %.1f%% of audio escalated, +%.0f ms average, %llu past deadline",
+                obs_source_get_name(context), (unsigned long long)windows,
+                100.0 * (double)escalated / (double)max<uint64_t>(cascade_audio_16k.load(), 1),
+                (double)latency / (double)windows, (unsigned long long)cascade_timeouts.load());
         }
+    }
+    escalations.erase(escalations.begin(), escalations.begin() + done);
+}
+
+void ProfanityFilter::MatchTokens(const SherpaOnnxOnlineRecognizerResult *result, size_t window_start,
+    const WordMatcher *matcher, const PinyinMatcher *pinyin_matcher, const TokenPinyinTable *pinyin_table,
+    const function<void(size_t, size_t, string, bool)> &on_match) {
+    size_t count = (size_t)result->count;
+    text_syllables.clear();
+    syllable_to_token.clear();
+
+    // Window text with prefix table: token_end[t - window_start] = byte offset just past token t
+    string window_text;
+    vector<size_t> token_end(count - window_start);
+    for (size_t t = window_start; t < count; t++) {
+        window_text += result->tokens_arr[t];
+        token_end[t - window_start] = window_text.size();
+    }
+
+    // 1. Word Matching (single pass over the window)
+    if (matcher) {
+        vector<WordMatcher::Match> word_matches;
+        matcher->FindAll(window_text, word_matches);
         
-        total_samples_popped_16k += chunk.size();
-        
-        // --- Gain Processing (AGC) ---
-        // Create a copy for model processing so output audio remains original
-        vector<float> model_chunk = chunk;
-        
-        if (enable_agc) {
-            // Automatic Gain Control
-            float peak = 0.0001f;
-            for (float s : model_chunk) {
-                float abs_s = fabsf(s);
-                if (abs_s > peak) peak = abs_s;
-            }
-            
-            // Target Peak: 0.6 (-4.4 dB)
-            float target_peak = 0.6f;
-            float desired_gain = target_peak / peak;
+        for (const auto& m : word_matches) {
+            // Byte offsets -> token indices via the prefix table
+            size_t start_token = upper_bound(token_end.begin(), token_end.end(), m.start) - token_end.begin();
+            size_t end_token = upper_bound(token_end.begin(), token_end.end(), m.start + m.length - 1) - token_end.begin();
+            if (end_token >= token_end.size()) continue;
             
-            // Constraints
-            if (desired_gain > 31.6f) desired_gain = 31.6f; // Max +30dB
-            if (desired_gain < 0.1f) desired_gain = 0.1f;   // Min -20dB
-            
-            // Smooth Update
-            if (desired_gain < current_agc_gain) {
-                // Attack (fast reduction)
-                current_agc_gain = current_agc_gain * 0.9f + desired_gain * 0.1f;
-            } else {
-                // Release (slow increase)
-                current_agc_gain = current_agc_gain * 0.99f + desired_gain * 0.01f;
+            on_match(window_start + start_token, window_start + end_token, window_text.substr(m.start, m.length), false);
+        }
+    }
+
+    // 2. Pinyin Matching (shared syllable automaton, single pass over the window)
+    if (pinyin_matcher && pinyin_table && pinyin_matcher->PatternCount() > 0) {
+        PinyinEngine &engine = PinyinEngine::Instance();
+
+        // Prepare text pinyin: token -> syllable IDs via the per-model table (no conversion, no allocation)
+        for(size_t t=window_start; t<count; t++) {
+            int32_t id = pinyin_table->Find(result->tokens_arr[t]);
+            if (id < 0) continue; // Not in vocabulary (should not happen for model output)
+            for (const int32_t *p = pinyin_table->SyllablesBegin(id); p != pinyin_table->SyllablesEnd(id); ++p) {
+                text_syllables.push_back(*p);
+                syllable_to_token.push_back(t);
             }
+        }
+        
+        // Match
+        pinyin_matches.clear();
+        pinyin_matcher->FindAll(text_syllables, pinyin_matches);
+        for (const auto& m : pinyin_matches) {
+            size_t start_token = syllable_to_token[m.start];
+            size_t end_token = syllable_to_token[m.start + m.length - 1];
             
-            // Apply to model_chunk ONLY
-            for (float &s : model_chunk) {
-                s *= current_agc_gain;
-                if (s > 1.0f) s = 1.0f;
-                if (s < -1.0f) s = -1.0f;
-            }
-        } else {
-             current_agc_gain = 1.0f; // Reset if disabled
+            stringstream ss;
+            ss << "已屏蔽(拼音): ";
+            for(int32_t p : pinyin_matcher->Pattern(m.pattern)) ss << engine.SyllableName(p) << " ";
+            ss << "[匹配源: ";
+            for(size_t k=0; k<m.length; k++) ss << engine.SyllableName(text_syllables[m.start+k]) << " ";
+            ss << "]";
+            
+            on_match(start_token, end_token, ss.str(), true);
         }
-        // ---------------------------------------
+    }
+}
 
-        if (asr_model && asr_model->recognizer && stream) {
-            SherpaOnnxOnlineStreamAcceptWaveform(stream, 16000, model_chunk.data(), (int32_t)model_chunk.size());
-            while (SherpaOnnxIsOnlineStreamReady(asr_model->recognizer, stream)) {
-                SherpaOnnxDecodeOnlineStream(asr_model->recognizer, stream);
+void ProfanityFilter::AsrHandleResult() {
+    // Decoding already happened in the pool (batched with other streams on the same model)
+    if (asr_model->keyword_spotter) {
+        AsrHandleKeywordResult();
+        return;
+    }
+
+    const SherpaOnnxOnlineRecognizerResult *result = SherpaOnnxGetOnlineStreamResult(asr_model->recognizer, stream);
+    if (result) {
+        // Get Patterns and Config from Global
+        GlobalConfig *cfg = GetGlobalConfig();
+        shared_ptr<const WordMatcher> matcher;
+        bool use_pinyin;
+        bool comedy_mode;
+        int model_offset_ms;
+        uint64_t words_generation;
+        {
+            lock_guard<mutex> lock(cfg->mutex);
+            matcher = cfg->word_matcher; // Shared, immutable
+            words_generation = cfg->words_generation;
+            use_pinyin = cfg->use_pinyin;
+            comedy_mode = cfg->comedy_mode;
+            model_offset_ms = cfg->model_offset_ms;
+        }
+        shared_ptr<const PinyinMatcher> pinyin_matcher = use_pinyin ? SharedPinyinMatcher::Instance().Get() : nullptr;
+        uint64_t pinyin_generation = pinyin_matcher ? pinyin_matcher->Generation() : 0;
+        
+        if (result->count > 0) {
+            if (result->text && result->text[0]) {
+                lock_guard<mutex> lock(history_mutex);
+                current_partial_text = result->text;
             }
             
-            const SherpaOnnxOnlineRecognizerResult *result = SherpaOnnxGetOnlineStreamResult(asr_model->recognizer, stream);
-            if (result) {
-                // Get Patterns and Config from Global
-                GlobalConfig *cfg = GetGlobalConfig();
-                vector<regex> patterns;
-                bool use_pinyin;
-                bool comedy_mode;
-                int model_offset_ms;
-                string current_dirty_words;
-                {
-                    lock_guard<mutex> lock(cfg->mutex);
-                    patterns = cfg->dirty_patterns; // Copy
-                    use_pinyin = cfg->use_pinyin;
-                    comedy_mode = cfg->comedy_mode;
-                    model_offset_ms = cfg->model_offset_ms;
-                    current_dirty_words = cfg->dirty_words_str;
-                }
-                
-                if (result->count > 0) {
-                    string full_text = "";
-                    // Reconstruct text
-                    for(int i=0; i<result->count; i++) full_text += result->tokens_arr[i];
+            // Incremental window: tokens before stable_tokens were already matched, so only the
+            // unstable tail plus enough overlap for the longest pattern is re-examined.
+            // A changed word list or pinyin toggle forces one full rescan.
+            size_t count = (size_t)result->count;
+            size_t window_start = 0;
+            size_t longest = matcher ? matcher->MaxMatchChars() : 0;
+            if (pinyin_matcher) longest = max(longest, pinyin_matcher->MaxPatternLength());
+            bool rules_changed = match_cursor.words_generation != words_generation || match_cursor.pinyin_generation != pinyin_generation;
+            if (!rules_changed && longest != SIZE_MAX) {
+                size_t cursor = min(match_cursor.stable_tokens, count);
+                window_start = (cursor > longest) ? cursor - longest : 0;
+            }
+            match_cursor.words_generation = words_generation;
+            match_cursor.pinyin_generation = pinyin_generation;
+            
+            // Collect Candidates
+            struct MatchCandidate {
+                size_t start_token;
+                size_t end_token;
+                uint64_t start_sample;
+                uint64_t end_sample;
+                uint64_t start_16k;
+                string log_text;
+                bool is_pinyin;
+            };
+            vector<MatchCandidate> candidates;
+            
+            // Absolute token range [start_token, end_token] -> absolute input samples
+            MatchTokens(result, window_start, matcher.get(), pinyin_matcher.get(), asr_model->pinyin_table.get(),
+                [&](size_t start_token, size_t end_token, string log_text, bool is_pinyin) {
+                    float start_time = result->timestamps[start_token];
+                    float end_time = (end_token + 1 < count) ? result->timestamps[end_token+1] : (result->timestamps[end_token] + 0.2f);
                     
-                    if (!full_text.empty()) {
-                        {
-                            lock_guard<mutex> lock(history_mutex);
-                            current_partial_text = full_text;
-                        }
-                    }
+                    uint64_t start_abs, end_abs;
+                    StreamTimeToInput(last_reset_sample_16k, start_time, end_time, model_offset_ms, start_abs, end_abs);
+                    candidates.push_back({start_token, end_token, start_abs, end_abs,
+                        last_reset_sample_16k + (uint64_t)(start_time * 16000.0f), std::move(log_text), is_pinyin});
+                });
 
-                    // Collect Candidates
-                    struct MatchCandidate {
-                        size_t start_char;
-                        uint64_t start_sample;
-                        uint64_t end_sample;
-                        string log_text;
-                        bool is_pinyin;
-                    };
-                    vector<MatchCandidate> candidates;
-
-                    // 1. Regex Matching
-                    for (const auto& pattern : patterns) {
-                        sregex_iterator begin(full_text.begin(), full_text.end(), pattern);
-                        sregex_iterator end;
-                        
-                        for (auto i = begin; i != end; ++i) {
-                            smatch match = *i;
-                            size_t m_start_char = match.position();
-                            
-                            // Find timestamps
-                            float m_start_time = -1.0f;
-                            float m_end_time = -1.0f;
-                            
-                            size_t current_char = 0;
-                            for(int t=0; t<result->count; t++) {
-                                string tok = result->tokens_arr[t];
-                                size_t tok_len = tok.length();
-                                float tok_start = result->timestamps[t];
-                                float tok_end = (t < result->count - 1) ? result->timestamps[t+1] : (tok_start + 0.2f);
-                                
-                                // Check overlap
-                                size_t m_end_char = m_start_char + match.length();
-                                if (current_char + tok_len > m_start_char && current_char < m_end_char) {
-                                    if (m_start_time < 0) m_start_time = tok_start;
-                                    m_end_time = tok_end;
-                                }
-                                current_char += tok_len;
-                            }
-                            
-                            if (m_start_time >= 0) {
-                                uint64_t start_16k = last_reset_sample_16k + (uint64_t)(m_start_time * 16000.0f);
-                                uint64_t end_16k = last_reset_sample_16k + (uint64_t)(m_end_time * 16000.0f);
-                                
-                                uint64_t start_abs = (uint64_t)(start_16k * current_ratio) + start_offset_input;
-                                uint64_t end_abs = (uint64_t)(end_16k * current_ratio) + start_offset_input;
-                                
-                                // Apply Model Latency Offset
-                                int64_t offset_samples = (int64_t)((model_offset_ms / 1000.0) * current_sr);
-                                if (offset_samples >= 0) {
-                                    start_abs += offset_samples;
-                                    end_abs += offset_samples;
-                                } else {
-                                    uint64_t sub = (uint64_t)(-offset_samples);
-                                    start_abs = (start_abs > sub) ? start_abs - sub : 0;
-                                    end_abs = (end_abs > sub) ? end_abs - sub : 0;
-                                }
-                                
-                                // Safe margin: 150ms = 0.15 * sr (Reduced from 400ms to avoid false positives)
-                                uint32_t margin = (uint32_t)(0.15 * current_sr);
-                                start_abs = (start_abs > margin) ? start_abs - margin : 0; 
-                                end_abs += margin; 
-                                
-                                candidates.push_back({m_start_char, start_abs, end_abs, match.str(), false});
-                            }
-                        }
-                    }
+            // Cascade: near misses without an exact match are re-decoded by the large model.
+            // MatchTokens left the window's syllables in text_syllables.
+            auto& escalated = match_cursor.escalated;
+            escalated.erase(escalated.begin(), escalated.lower_bound(window_start));
+            if (cascade_model && pinyin_matcher && !text_syllables.empty()) {
+                near_matches.clear();
+                pinyin_matcher->FindNear(text_syllables, near_initials, near_matches);
+                for (const auto& m : near_matches) {
+                    size_t start_token = syllable_to_token[m.start];
+                    size_t end_token = syllable_to_token[m.start + m.length - 1];
+                    bool exact = any_of(candidates.begin(), candidates.end(), [&](const MatchCandidate &c) {
+                        return c.start_token <= end_token && start_token <= c.end_token;
+                    });
+                    if (exact || !escalated.insert(start_token).second) continue;
+                    
+                    float start_time = result->timestamps[start_token];
+                    float end_time = (end_token + 1 < count) ? result->timestamps[end_token+1] : (result->timestamps[end_token] + 0.2f);
+                    string text;
+                    for (size_t t = start_token; t <= end_token; t++) text += result->tokens_arr[t];
+                    Escalate(last_reset_sample_16k + (uint64_t)(start_time * 16000.0f),
+                        last_reset_sample_16k + (uint64_t)(end_time * 16000.0f), 0, text);
+                }
+            }
 
-                    // 2. Pinyin Matching
-                    if (use_pinyin) {
-                        if (!pinyin_converter) {
-                            // Try to locate dict directory relative to the plugin DLL
-                            string dict_path;
-                            
-                            // Method 1: Try OBS data path (Standard Install)
-                            char *obs_data_ptr = obs_module_file("dict");
-                            if (obs_data_ptr) {
-                                if (filesystem::exists(obs_data_ptr)) {
-                                    dict_path = obs_data_ptr;
-                                }
-                                bfree(obs_data_ptr);
-                            }
-                            
-                            // Method 2: Try next to DLL (Portable / Dev) or Self-contained bundle
-                                if (dict_path.empty()) {
-                                    HMODULE hMod = nullptr;
-                                    MEMORY_BASIC_INFORMATION mbi;
-                                    if (VirtualQuery((LPCVOID)&ModuleLocator, &mbi, sizeof(mbi))) {
-                                        hMod = (HMODULE)mbi.AllocationBase;
-                                    }
-                                    
-                                    if (hMod) {
-                                        char path[MAX_PATH];
-                                        if (GetModuleFileNameA(hMod, path, MAX_PATH)) {
-                                            filesystem::path p(path);
-                                            
-                                            // 1. Check next to DLL (e.g. local build: bin/64bit/dict)
-                                            filesystem::path p_next = p.parent_path() / "dict";
-                                            if (filesystem::exists(p_next)) {
-                                                dict_path = p_next.string();
-                                            } else {
-                                                // 2. Check standard plugin structure (root/data/dict)
-                                                filesystem::path p_bundle = p.parent_path().parent_path().parent_path() / "data" / "dict";
-                                                if (filesystem::exists(p_bundle)) {
-                                                    dict_path = p_bundle.string();
-                                                }
-                                            }
-                                        }
-                                    }
-                                }
-
-                            if (!dict_path.empty()) {
-                                Pinyin::setDictionaryPath(dict_path);
-                                pinyin_converter = make_shared<Pinyin::Pinyin>();
-                                BLOG(LOG_INFO, "Pinyin Engine Initialized from: %s", dict_path.c_str());
-                            } else {
-                                static bool logged_error = false;
-                                if (!logged_error) {
-                                    BLOG(LOG_ERROR, "Error: Could not find 'dict' directory for Pinyin engine.");
-                                    logged_error = true;
-                                }
-                            }
-                        }
-
-                        if (pinyin_converter) {
-                            // Update patterns if changed
-                            if (current_dirty_words != cached_dirty_words_str_for_pinyin) {
-                                cached_pinyin_patterns.clear();
-                                stringstream ss(current_dirty_words);
-                                string item;
-                                while (getline(ss, item, ',')) {
-                                    item.erase(0, item.find_first_not_of(" \t\n\r"));
-                                    item.erase(item.find_last_not_of(" \t\n\r") + 1);
-                                    if (!item.empty()) {
-                                        auto res = pinyin_converter->hanziToPinyin(item, Pinyin::ManTone::Style::NORMAL, Pinyin::Error::Default, false, false);
-                                        vector<string> pat;
-                                        for(const auto& r : res) {
-                                            if (!r.pinyin.empty() && r.pinyin != " ") {
-                                                    pat.push_back(NormalizePinyin(r.pinyin));
-                                            }
-                                        }
-                                        if (!pat.empty()) cached_pinyin_patterns.push_back(pat);
-                                    }
-                                }
-                                cached_dirty_words_str_for_pinyin = current_dirty_words;
-                            }
-
-                            // Prepare text pinyin
-                            vector<string> text_pinyins;
-                            vector<int> pinyin_to_token;
-                            
-                            for(int t=0; t<result->count; t++) {
-                                string tok = result->tokens_arr[t];
-                                
-                                // Try cache first
-                                vector<string> pinyins;
-                                auto it = pinyin_cache.find(tok);
-                                if (it != pinyin_cache.end()) {
-                                    pinyins = it->second;
-                                } else {
-                                    // Not in cache, convert
-                                    auto res = pinyin_converter->hanziToPinyin(tok, Pinyin::ManTone::Style::NORMAL, Pinyin::Error::Default, false, false);
-                                    for(const auto& r : res) {
-                                            if (!r.pinyin.empty() && r.pinyin != " ") {
-                                                pinyins.push_back(NormalizePinyin(r.pinyin));
-                                            }
-                                    }
-                                    // Store in cache (limit size to prevent memory leak)
-                                    if (pinyin_cache.size() > 5000) pinyin_cache.clear();
-                                    pinyin_cache[tok] = pinyins;
-                                }
-
-                                for(const auto& p : pinyins) {
-                                        text_pinyins.push_back(p);
-                                        pinyin_to_token.push_back(t);
-                                }
-                            }
-                            
-                            // Debug Log Pinyin (First 3s only to avoid spam)
-                            static int debug_log_count = 0;
-                            if (debug_log_count < 3 && !text_pinyins.empty()) {
-                                stringstream ss;
-                                ss << "DEBUG Pinyin: ";
-                                for(auto& p : text_pinyins) ss << p << " ";
-                                BLOG(LOG_INFO, "%s", ss.str().c_str());
-                                debug_log_count++;
-                            }
-
-                            // Match
-                            for (const auto& pat : cached_pinyin_patterns) {
-                                if (pat.size() > text_pinyins.size()) continue;
-                                for (size_t i = 0; i <= text_pinyins.size() - pat.size(); ++i) {
-                                    bool match = true;
-                                    for (size_t j = 0; j < pat.size(); ++j) {
-                                        if (text_pinyins[i+j] != pat[j]) {
-                                            match = false;
-                                            break;
-                                        }
-                                    }
-                                    
-                                    if (match) {
-                                        int start_token = pinyin_to_token[i];
-                                        int end_token = pinyin_to_token[i + pat.size() - 1];
-                                        
-                                        // Calculate char pos for processed_matches check
-                                        size_t char_pos = 0;
-                                        for(int k=0; k<start_token; k++) char_pos += string(result->tokens_arr[k]).length();
-                                        
-                                        float start_time = result->timestamps[start_token];
-                                        float end_time = (end_token < result->count - 1) ? result->timestamps[end_token+1] : (result->timestamps[end_token] + 0.2f);
-                                        
-                                        uint64_t start_16k = last_reset_sample_16k + (uint64_t)(start_time * 16000.0f);
-                                        uint64_t end_16k = last_reset_sample_16k + (uint64_t)(end_time * 16000.0f);
-                                        
-                                        uint64_t start_abs = (uint64_t)(start_16k * current_ratio) + start_offset_input;
-                                        uint64_t end_abs = (uint64_t)(end_16k * current_ratio) + start_offset_input;
-
-                                        // Apply Model Latency Offset
-                                        int64_t offset_samples = (int64_t)((model_offset_ms / 1000.0) * current_sr);
-                                        if (offset_samples >= 0) {
-                                            start_abs += offset_samples;
-                                            end_abs += offset_samples;
-                                        } else {
-                                            uint64_t sub = (uint64_t)(-offset_samples);
-                                            start_abs = (start_abs > sub) ? start_abs - sub : 0;
-                                            end_abs = (end_abs > sub) ? end_abs - sub : 0;
-                                        }
-                                        
-                                        // Safe margin: 150ms = 0.15 * sr
-                                        uint32_t margin = (uint32_t)(0.15 * current_sr);
-                                        start_abs = (start_abs > margin) ? start_abs - margin : 0; 
-                                        end_abs += margin; 
-                                        
-                                        stringstream ss;
-                                        ss << "已屏蔽(拼音): ";
-                                        for(const auto& p : pat) ss << p << " ";
-                                        ss << "[匹配源: ";
-                                        for(int k=0; k<pat.size(); k++) ss << text_pinyins[i+k] << " ";
-                                        ss << "]";
-                                        
-                                        candidates.push_back({char_pos, start_abs, end_abs, ss.str(), true});
-                                    }
-                                }
-                            }
-                        }
-                    }
+            // 3. Sort and Apply Candidates
+            if (comedy_mode) {
+                // Comedy Mode: Shortest First
+                sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b){
+                    return (a.end_sample - a.start_sample) < (b.end_sample - b.start_sample);
+                });
+            } else {
+                // Normal Mode: Longest First (Cover max area)
+                sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b){
+                    return (a.end_sample - a.start_sample) > (b.end_sample - b.start_sample);
+                });
+            }
 
-                    // 3. Sort and Apply Candidates
-                    if (comedy_mode) {
-                        // Comedy Mode: Shortest First
-                        sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b){
-                            return (a.end_sample - a.start_sample) < (b.end_sample - b.start_sample);
-                        });
-                    } else {
-                        // Normal Mode: Longest First (Cover max area)
-                        sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b){
-                            return (a.end_sample - a.start_sample) > (b.end_sample - b.start_sample);
-                        });
-                    }
+            // Matches starting before the window can never be seen again
+            auto& reported = match_cursor.reported;
+            reported.erase(reported.begin(), reported.lower_bound(window_start));
 
-                    vector<pair<uint64_t, uint64_t>> covered_intervals;
-                    for(const auto& m : candidates) {
-                        // Skip if already processed in previous frames
-                        if (processed_matches.count(m.start_char)) continue;
-                        
-                        // Check overlap with currently selected candidates in this frame
-                        bool overlap = false;
-                        for(const auto& interval : covered_intervals) {
-                            if (m.start_sample < interval.second && m.end_sample > interval.first) {
-                                overlap = true;
-                                break;
-                            }
-                        }
-                        
-                        if (!overlap) {
-                            lock_guard<mutex> b_lock(beep_mutex);
-                            pending_beeps.push_back({m.start_sample, m.end_sample, m.start_sample});
-                            BLOG(LOG_INFO, "%s", m.log_text.c_str());
-                            
-                            covered_intervals.push_back({m.start_sample, m.end_sample});
-                        }
-                        
-                        // Always mark as processed to prevent re-evaluation or double-application
-                        processed_matches.insert(m.start_char);
+            vector<pair<uint64_t, uint64_t>> covered_intervals;
+            for(const auto& m : candidates) {
+                // Skip if already processed in previous frames
+                if (reported.count(m.start_token)) continue;
+                
+                // Check overlap with currently selected candidates in this frame
+                bool overlap = false;
+                for(const auto& interval : covered_intervals) {
+                    if (m.start_sample < interval.second && m.end_sample > interval.first) {
+                        overlap = true;
+                        break;
                     }
                 }
-                SherpaOnnxDestroyOnlineRecognizerResult(result);
+                
+                if (!overlap) {
+                    if (QueueBeep(m.start_sample, m.end_sample, m.start_16k)) {
+                        BLOG(LOG_INFO, "%s", m.log_text.c_str());
+                    }
+                    
+                    covered_intervals.push_back({m.start_sample, m.end_sample});
+                }
+                
+                // Always mark as processed to prevent re-evaluation or double-application
+                reported.insert(m.start_token);
             }
             
-            // Check endpoint or force reset if segment is too long (> 600s = 10min)
-            bool force_reset = (total_samples_popped_16k - last_reset_sample_16k) > (16000 * 600);
+            // Everything but the unstable tail is final for the next chunk
+            match_cursor.stable_tokens = (count > kUnstableTailTokens) ? count - kUnstableTailTokens : 0;
+        }
+        SherpaOnnxDestroyOnlineRecognizerResult(result);
+    }
+    
+    // Check endpoint or force reset if segment is too long (> 600s = 10min)
+    bool force_reset = (total_samples_popped_16k - last_reset_sample_16k) > (16000 * 600);
 
-            if (force_reset || SherpaOnnxOnlineStreamIsEndpoint(asr_model->recognizer, stream)) {
-                if (force_reset) {
-                    BLOG(LOG_INFO, "Info: Periodic reset of ASR stream (segment > 10min)");
-                }
-                SherpaOnnxOnlineStreamReset(asr_model->recognizer, stream);
-                last_reset_sample_16k = total_samples_popped_16k;
-                {
-                    lock_guard<mutex> lock(history_mutex);
-                    current_partial_text = "";
-                }
-                processed_matches.clear();
-            }
+    if (force_reset || SherpaOnnxOnlineStreamIsEndpoint(asr_model->recognizer, stream)) {
+        if (force_reset) {
+            BLOG(LOG_INFO, "Info: Periodic reset of ASR stream (segment > 10min)");
         }
+        asr_model->ResetStream(stream);
+        last_reset_sample_16k = total_samples_popped_16k;
+        at_segment_boundary = true;
+        {
+            lock_guard<mutex> lock(history_mutex);
+            current_partial_text = "";
+        }
+        ResetMatchCursor();
     }
 }
 
+// Audio seconds between two callback cost log lines
+static constexpr double kCallbackStatsPeriodSeconds = 300.0;
+
+void ProfanityFilter::RecordCallback(chrono::steady_clock::duration elapsed, size_t frames, size_t planes, uint32_t sr) {
+    uint64_t ns = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
+    callback_stats.ns += ns;
+    callback_stats.max_ns = max(callback_stats.max_ns, ns);
+    callback_stats.frames += frames;
+    callback_stats.blocks++;
+    if ((double)callback_stats.frames < kCallbackStatsPeriodSeconds * sr) return;
+
+    // Share of real time spent in the callback, per block and at worst
+    double audio_ns = (double)callback_stats.frames * 1e9 / sr;
+    BLOG(LOG_INFO, "Audio callback of '%s' (%zu ch, %u Hz, %zu-frame blocks): %.1f us avg, %.1f us max, %.3f%% of real time",
+        obs_source_get_name(context), planes, sr, frames, callback_stats.ns / 1000.0 / callback_stats.blocks,
+        callback_stats.max_ns / 1000.0, 100.0 * (double)callback_stats.ns / audio_ns);
+    callback_stats = CallbackStats();
+}
+
 struct obs_audio_data *ProfanityFilter::ProcessAudio(struct obs_audio_data *audio) {
     uint32_t frames = audio->frames;
     if (!audio->data[0]) return audio;
@@ -676,7 +1283,7 @@ struct obs_audio_data *ProfanityFilter::ProcessAudio(struct obs_audio_data *audi
     // Sync with Global Config
     GlobalConfig *cfg = GetGlobalConfig();
     double global_delay;
-    string global_model;
+    bool has_model;
     int global_effect; // 0=Beep, 1=Silence, 2=Squeaky, 3=Robot
     int global_freq;
     int global_mix;
@@ -685,28 +1292,58 @@ struct obs_audio_data *ProfanityFilter::ProcessAudio(struct obs_audio_data *audi
     {
         lock_guard<mutex> lock(cfg->mutex);
         global_delay = cfg->delay_seconds;
-        global_model = cfg->model_path;
+        has_model = !cfg->model_path.empty();
         global_effect = cfg->audio_effect;
         global_freq = cfg->beep_frequency;
         global_mix = cfg->beep_mix_percent;
         global_enable = cfg->global_enable;
     }
     
-    // If disabled globally, pass through and signal unload
+    // If disabled globally, pass through (ASR thread picks up the unload from the global config)
     if (!global_enable) {
-        {
-            lock_guard<mutex> lock(queue_mutex);
-            target_model_path = ""; // Signal unload
-        }
         return audio;
     }
     
     // Update Filter State
-    {
-        lock_guard<mutex> lock(queue_mutex);
-        target_model_path = global_model;
-    }
     cached_delay = global_delay;
+    auto callback_start = chrono::steady_clock::now();
+    
+    // Delay line: take over the storage prepared by ReserveDelayLine. The history is copied in slices of
+    // kHandoverSamples per callback while this block's write goes to both lines, the lock is kept until
+    // that write. Never allocates or frees here, the old storage is released by the ASR worker.
+    // Settled before the ASR feed: a block that skips the delay line must not reach asr_ring either,
+    // or the 16k timeline (start_offset_input) drifts against the delay line positions.
+    unique_lock<mutex> handover_lock;
+    if (delay_line_ready.load(memory_order_acquire)) {
+        unique_lock<mutex> lock(delay_mutex, try_to_lock);
+        if (lock.owns_lock() && delay_line_ready.load()) {
+            if (!delay_handover) {
+                delay_line_next.BeginHandover(delay_line);
+                delay_handover = true;
+            }
+            size_t slice = kHandoverSamples / max<size_t>(delay_line_next.Channels(), 1);
+            if (delay_line_next.ContinueHandover(delay_line, slice)) {
+                delay_line.Swap(delay_line_next);
+                delay_capacity = delay_line.Capacity();
+                delay_channels = delay_line.Channels();
+                delay_handover = false;
+                delay_line_ready = false;
+                delay_line_retired = true;
+            } else {
+                handover_lock = move(lock); // delay_line_next receives this block as well
+            }
+        } else {
+            // A write delay_line_next misses (or it was replaced): start over next time
+            delay_handover = false;
+        }
+    }
+    if (delay_line.Capacity() == 0) {
+        // Not adopted yet (first callback raced a resize): keep the output delayed rather than leak live audio
+        for (size_t c = 0; c < MAX_AV_PLANES; c++) {
+            if (audio->data[c]) memset(audio->data[c], 0, frames * sizeof(float));
+        }
+        return audio;
+    }
     
     // 1. Push to ASR (Only if enabled and model loaded)
     // But we always calculate RMS for status
@@ -727,247 +1364,174 @@ struct obs_audio_data *ProfanityFilter::ProcessAudio(struct obs_audio_data *audi
     if (sample_rate != current_sr) {
         sample_rate = current_sr;
         sample_rate_ratio = (double)current_sr / 16000.0;
-        // Reset resampler
-        resample_acc = 0.0f;
     }
-    
-    double current_ratio = sample_rate_ratio.load();
-
-    if (enabled && !target_model_path.empty()) {
-        lock_guard<mutex> lock(queue_mutex);
-
-        // Safety: Limit queue size to prevent memory leak if ASR is too slow
-        // Limit to ~60 seconds of audio (16000 * 60 = 960,000 samples)
-        if (asr_queue.size() > 960000) {
-            asr_queue.clear();
+    if (resampler.InputRate() != current_sr && resampler_ready.load(memory_order_acquire)) {
+        // Filter bank for the new rate, built by ReserveDelayLine
+        unique_lock<mutex> lock(resampler_mutex, try_to_lock);
+        if (lock.owns_lock() && resampler_ready.load() && resampler_next.InputRate() == current_sr) {
+            resampler.Swap(resampler_next);
+            resampler_ready = false;
         }
+    }
 
-        // Dynamic Downsampling (Nearest Neighbor / Accumulator)
-        for (size_t i = 0; i < frames; i++) {
-                resample_acc += 1.0f;
-                if (resample_acc >= current_ratio) {
-                    resample_acc -= (float)current_ratio;
-                    asr_queue.push_back(input[i]);
-                }
+    if (enabled && has_model && resampler.InputRate() != current_sr) {
+        // No filter bank for this rate yet: dropped like an overflow, the ASR side resyncs
+        asr_ring.Drop((size_t)((uint64_t)frames * 16000 / current_sr));
+    } else if (enabled && has_model) {
+        size_t max_out = resampler.MaxOutput(frames);
+        if (asr_scratch.size() < max_out) asr_scratch.resize(max_out); // Only if OBS ever exceeds the preallocated block
+
+        // Anti-aliased polyphase downsampling (exact rational ratio, whole block)
+        // Group delay is ~64 input samples (~1.3 ms), well inside the model offset calibration range.
+        size_t n_out = resampler.Process(input, frames, asr_scratch.data());
+        
+        // Single block write, lock-free. If ASR is too slow (~65s backlog) the block is dropped
+        // and counted; the ASR thread notices the overflow and resyncs.
+        asr_ring.Write(asr_scratch.data(), n_out);
+        if (asr_ring.Size() >= asr_wake_samples.load(memory_order_relaxed)) {
+            ASRWorkerPool::Instance().Notify();
         }
     }
     
-    // 2. Buffer Logic
-    if (channels.empty()) {
-        for (size_t c = 0; c < 8; c++) {
-            if (audio->data[c]) channels_count++; else break;
-        }
-        if (channels_count == 0) channels_count = 1;
-        channels.resize(channels_count);
-        
-        size_t buf_size = current_sr * 12; // Max 12s
-        for (auto& ch : channels) {
-            ch.buffer.resize(buf_size, 0.0f);
-            ch.clean_buffer.resize(buf_size, 0.0f);
-        }
-    }
-    
-    // Ensure buffer size covers delay
-    size_t delay_samples = (size_t)(cached_delay * current_sr);
-    size_t current_buf_size = channels[0].buffer.size();
-    
-    // Resize check (handle sample rate change or large delay)
-    if (delay_samples * 2 > current_buf_size || current_buf_size != current_sr * 12) {
-            size_t new_size = max((size_t)(current_sr * 12), delay_samples * 2);
-            if (new_size != current_buf_size) {
-                current_buf_size = new_size;
-                for (auto& ch : channels) {
-                    vector<float> new_buf(new_size, 0.0f);
-                    ch.buffer = new_buf;
-                    ch.clean_buffer = new_buf;
-                    ch.head = 0;
-                }
-            }
-    }
+    size_t planes = 0;
+    while (planes < MAX_AV_PLANES && audio->data[planes]) planes++;
     
-    if (delay_samples >= current_buf_size) delay_samples = current_buf_size - current_sr;
+    // Clamped to what the line holds until a larger one is in place
+    size_t delay_samples = (size_t)(cached_delay.load(memory_order_relaxed) * current_sr);
+    size_t max_delay = delay_line.Capacity() - min(delay_line.Capacity(), frames + CensorRenderer::kLookback);
+    if (delay_samples > max_delay) delay_samples = max_delay;
     
     // Write to buffer
-    for (size_t c = 0; c < channels_count; c++) {
-        if (!audio->data[c]) continue;
-        float *data_in = (float *)audio->data[c];
-        auto& ch = channels[c];
-        for (size_t i = 0; i < frames; i++) {
-            ch.buffer[ch.head] = data_in[i];
-            ch.clean_buffer[ch.head] = data_in[i];
-            ch.head = (ch.head + 1) % current_buf_size;
-            ch.total_written++;
-        }
+    delay_line.Write((const float *const *)audio->data, planes, frames);
+    if (handover_lock.owns_lock()) {
+        delay_line_next.Write((const float *const *)audio->data, planes, frames);
+        handover_lock.unlock();
     }
     total_samples_written.fetch_add(frames);
     
-    // Apply Beeps (Only if enabled)
+    // This call plays out [out_start, out_end) (absolute input samples, out_start may be negative at startup)
+    uint64_t current_written = delay_line.End();
+    int64_t out_end = (int64_t)current_written - (int64_t)delay_samples;
+    int64_t out_start = out_end - (int64_t)frames;
+    uint64_t play_head_pos = (out_start > 0) ? (uint64_t)out_start : 0; // First sample not played out yet
+    
+    // Censor regions are applied as samples leave the delay line, the buffer itself stays pristine.
+    // A region can be added (or revised) by the ASR side until its audio plays out. Its replacement audio
+    // is normally rendered there already (PrepareBeep), so this only crossfades it in.
+    censor_renderer.Configure(current_sr, global_effect, global_freq, global_mix);
+    size_t ramp = censor_renderer.RampSamples();
+    uint64_t signature = censor_renderer.Signature();
+    censor_spans.clear();
     if (enabled) {
         lock_guard<mutex> lock(beep_mutex);
-        uint64_t current_write_pos = channels[0].total_written;
-        uint64_t play_head_pos = 0;
-        if (current_write_pos > delay_samples) {
-            play_head_pos = current_write_pos - delay_samples;
-        }
-        
-        for (auto it = pending_beeps.begin(); it != pending_beeps.end(); ) {
-                // 1. Handling Late Beeps (Latency > Delay)
-                if (it->start_sample < play_head_pos) {
-                    it->start_sample = play_head_pos;
-                }
-
-                uint64_t start = it->start_sample;
-                uint64_t end = it->end_sample;
-                
-                if (start >= end) {
-                    size_t dropped = ++dropped_beeps_count;
-                    if (dropped <= 5 || dropped % 10 == 0) {
-                        BLOG(LOG_WARNING, "Beep dropped! Latency > Delay. Increase delay setting. (Start: %llu, End: %llu, Head: %llu)", 
-                            (unsigned long long)start, (unsigned long long)end, (unsigned long long)play_head_pos);
-                    }
-
-                    it = pending_beeps.erase(it);
-                    continue;
-                }
-                
-                if (end < current_write_pos - current_buf_size) {
-                    it = pending_beeps.erase(it);
-                    continue;
-                }
-                
-                for (size_t c = 0; c < channels_count; c++) {
-                    auto& ch = channels[c];
-                    
-                    // Minion Effect: Pre-fetch original audio to avoid feedback loop
-                    // Only needed for global_effect == 2
-                    std::vector<float> temp_source;
-                    uint64_t temp_start_idx = 0;
-                    if (global_effect == 2) {
-                        uint64_t window_size = 2048; // Approx 40ms
-                        // Ensure we have enough history for pitch shifter lookback
-                        uint64_t safe_start = (start > window_size) ? start - window_size : 0;
-                        // Check buffer limits (don't go before what we have)
-                        if (safe_start < current_write_pos - current_buf_size) {
-                             safe_start = current_write_pos - current_buf_size;
-                        }
-                        
-                        temp_start_idx = safe_start;
-                        size_t len = (size_t)(end - safe_start);
-                        temp_source.resize(len);
-                        
-                        for(size_t k=0; k<len; k++) {
-                             uint64_t s_abs = safe_start + k;
-                             size_t diff = (size_t)(current_write_pos - s_abs);
-                             size_t idx = (ch.head + current_buf_size - (diff % current_buf_size)) % current_buf_size;
-                             temp_source[k] = ch.clean_buffer[idx];
-                        }
-                    }
-
-                    for (uint64_t s = start; s < end; s++) {
-                        if (s >= current_write_pos) break; 
-                        if (s < current_write_pos - current_buf_size) continue;
-                        
-                        size_t diff = (size_t)(current_write_pos - s);
-                        size_t idx = (ch.head + current_buf_size - (diff % current_buf_size)) % current_buf_size;
-                        
-                        float val = 0.0f;
-                        float original = ch.buffer[idx];
-                        float mix = (float)global_mix / 100.0f;
-
-                        if (global_effect == 1) { // Silence
-                             val = 0.0f;
-                        } else if (global_effect == 2) { // Minion (Pitch Shifter)
-                             // Barberpole Pitch Shifter
-                             // Pitch Ratio: 2.0 (Octave up) for sharper Minion sound
-                             double pitch_ratio = 2.0;
-                             double window_size = 2048.0; // Must match pre-fetch window approx
-                             
-                             // Phase runs 0..1
-                             double speed = pitch_ratio - 1.0;
-                             double phase = (double)(s % (uint64_t)(window_size / speed)) * speed / window_size;
-                             phase -= floor(phase);
-
-                             // Delay decreases from window_size to 0 for Pitch Up
-                             double delay_A = (1.0 - phase) * window_size;
-                             double delay_B = (1.0 - ((phase + 0.5) - floor(phase + 0.5))) * window_size;
-                             
-                             // Read from temp_source
-                             // temp_source[0] corresponds to temp_start_idx
-                             // Current time s corresponds to index (s - temp_start_idx)
-                             // We want to read at (s - delay)
-                             
-                             int64_t read_idx_A = (int64_t)(s - temp_start_idx) - (int64_t)delay_A;
-                             int64_t read_idx_B = (int64_t)(s - temp_start_idx) - (int64_t)delay_B;
-                             
-                             float sample_A = 0.0f;
-                             float sample_B = 0.0f;
-                             
-                             if (read_idx_A >= 0 && read_idx_A < (int64_t)temp_source.size()) sample_A = temp_source[read_idx_A];
-                             if (read_idx_B >= 0 && read_idx_B < (int64_t)temp_source.size()) sample_B = temp_source[read_idx_B];
-                             
-                             // Triangle Window
-                             float gain_A = 1.0f - 2.0f * (float)fabs(phase - 0.5);
-                             float gain_B = 1.0f - 2.0f * (float)fabs(((phase + 0.5) - floor(phase + 0.5)) - 0.5);
-                             
-                             val = sample_A * gain_A + sample_B * gain_B;
-                             mix = 1.0f; // Force wet mix for voice change
-                        } else if (global_effect == 3) { // Telegraph (Morse Code Style)
-                             double t = (double)s / (double)current_sr;
-                             
-                             // Carrier: 750Hz Sine Wave (Classic CW tone)
-                             double carrier = sin(2.0 * 3.14159265358979323846 * 750.0 * t);
-                             
-                             // Pseudo-random Morse Pattern Generator
-                             // Use sine waves at different prime frequencies to create a non-repeating pattern of "dits" and "dahs"
-                             // 8Hz = fast dits, 3Hz = word spacing rhythm
-                             double rhythm = sin(2.0 * 3.14159265358979323846 * 8.0 * t) + 
-                                             sin(2.0 * 3.14159265358979323846 * 3.0 * t);
-                             
-                             // Threshold to create on/off keying
-                             // If rhythm > 0, tone is ON. Else OFF.
-                             float envelope = (rhythm > 0.0) ? 1.0f : 0.0f;
-                             
-                             val = 0.15f * (float)carrier * envelope;
-                             mix = 1.0f; // Force 100% replacement
-                        } else { // Default: Beep
-                             double cycles = (double)s * (double)global_freq / (double)current_sr;
-                             double phase = cycles - floor(cycles);
-                             val = 0.1f * (float)sin(2.0 * 3.14159265358979323846 * phase);
-                        }
-                        
-                        ch.buffer[idx] = (val * mix) + (original * (1.0f - mix));
-                    }
-                }
-
-                if (end > current_write_pos) {
-                    if (it->start_sample < current_write_pos) {
-                        it->start_sample = current_write_pos;
+        for (auto &beep : pending_beeps) {
+            if (beep.cancelled && !beep.started) continue; // Withdrawn by the cascade, dropped below
+            
+            // Deadline check, once per beep: audio before the play head is already out
+            if (!beep.scheduled) {
+                beep.scheduled = true;
+                uint64_t scheduled = ++beeps_scheduled;
+                if (beep.start_sample < play_head_pos) {
+                    uint64_t misses = ++deadline_misses;
+                    if (misses <= 5 || misses % 10 == 0) {
+                        double late_ms = (double)(play_head_pos - beep.start_sample) * 1000.0 / current_sr;
+                        BLOG(LOG_WARNING, "Deadline miss on '%s': match arrived %.0f ms after playout%s (miss rate %.1f%%, %llu/%llu). Increase delay setting.",
+                            obs_source_get_name(context), late_ms, (beep.end_sample <= play_head_pos) ? ", dropped" : ", censored late",
+                            100.0 * (double)misses / (double)scheduled, (unsigned long long)misses, (unsigned long long)scheduled);
                     }
-                    ++it;
-                } else {
-                    it = pending_beeps.erase(it);
                 }
+            }
+            
+            // Regions touching this block, including their edge fades (late beeps only cover what has not played yet)
+            int64_t reach_start = (int64_t)beep.start_sample - (int64_t)ramp;
+            int64_t reach_end = (int64_t)(beep.end_sample + ramp);
+            if (reach_start < out_end && reach_end > out_start) {
+                beep.started = true; // From here on it can no longer be withdrawn
+                // A segment rendered with other settings (effect changed since) is not used
+                bool usable = beep.segment >= 0 && beep.signature == signature;
+                const vector<float> *segment = usable ? &segment_pool[beep.segment] : nullptr;
+                censor_spans.push_back({beep.start_sample, beep.end_sample, segment ? segment->data() : nullptr,
+                                        beep.segment_start, segment ? segment->size() : 0});
+            }
+        }
+    }
+    // Overlapping matches censor a sample once, regions closer than their fades are joined
+    sort(censor_spans.begin(), censor_spans.end(), [](const CensorSpan &a, const CensorSpan &b) { return a.start < b.start; });
+    censor_regions.clear();
+    for (size_t k = 0; k < censor_spans.size(); k++) {
+        const CensorSpan &span = censor_spans[k];
+        if (!censor_regions.empty() && span.start <= censor_regions.back().end + 2 * ramp) {
+            CensorRegion &region = censor_regions.back();
+            region.end = max(region.end, span.end);
+            region.last_span = k + 1;
+            region.prerendered = region.prerendered && span.wet;
+        } else {
+            censor_regions.push_back({span.start, span.end, k, k + 1, span.wet != nullptr});
         }
     }
     
     // Output Delayed
-    uint64_t current_written = channels[0].total_written;
-    for (size_t c = 0; c < channels_count; c++) {
-        if (!audio->data[c]) continue;
+    for (size_t c = 0; c < planes; c++) {
         float *data_out = (float *)audio->data[c];
-        auto& ch = channels[c];
+        if (c >= delay_line.Channels()) {
+            memset(data_out, 0, frames * sizeof(float));
+            continue;
+        }
+        delay_line.Read(c, out_start, frames, data_out);
+    }
+    size_t censor_planes = min(planes, delay_line.Channels());
+    for (const auto &region : censor_regions) {
+        int64_t from = max({(int64_t)region.start - (int64_t)ramp, out_start, (int64_t)0});
+        int64_t to = min((int64_t)(region.end + ramp), out_end);
+        if (from >= to) continue;
+        size_t n = (size_t)(to - from);
+        
+        if (region.prerendered) {
+            // Same replacement audio on every channel, stitched from the segments of the region's matches
+            // (segments overlap exactly, the oscillator phase follows the input position)
+            if (wet_scratch.size() < n) wet_scratch.resize(n); // Only if OBS exceeds the preallocated block
+            fill(wet_scratch.begin(), wet_scratch.begin() + n, 0.0f);
+            for (size_t k = region.first_span; k < region.last_span; k++) {
+                const CensorSpan &span = censor_spans[k];
+                int64_t copy_from = max(from, (int64_t)span.wet_start);
+                int64_t copy_to = min(to, (int64_t)(span.wet_start + span.wet_size));
+                if (copy_from >= copy_to) continue;
+                memcpy(wet_scratch.data() + (copy_from - from), span.wet + (copy_from - (int64_t)span.wet_start),
+                       (size_t)(copy_to - copy_from) * sizeof(float));
+            }
+            for (size_t c = 0; c < censor_planes; c++) {
+                float *data_out = (float *)audio->data[c];
+                censor_renderer.Mix(data_out + (from - out_start), wet_scratch.data(), n, (uint64_t)from, region.start, region.end);
+            }
+            continue;
+        }
         
-        for (size_t i = 0; i < frames; i++) {
-            int64_t target_abs = (int64_t)(current_written - frames + i) - (int64_t)delay_samples;
-            if (target_abs < 0) {
-                data_out[i] = 0.0f;
+        // Input-dependent effect (or settings changed after the match): rendered here
+        size_t needed = n + CensorRenderer::kLookback;
+        if (effect_scratch.size() < needed) effect_scratch.resize(needed); // Only if OBS exceeds the preallocated block
+        for (size_t c = 0; c < censor_planes; c++) {
+            float *data_out = (float *)audio->data[c];
+            // Pristine input of the span with the effect lookback in front of it
+            delay_line.Read(c, from - (int64_t)CensorRenderer::kLookback, needed, effect_scratch.data());
+            censor_renderer.Render(data_out + (from - out_start), effect_scratch.data() + CensorRenderer::kLookback,
+                                   n, (uint64_t)from, region.start, region.end);
+        }
+    }
+    
+    // Played out (or withdrawn before playout): drop the beeps and hand their segments back to the pool
+    // (after the output, which read them; a withdrawn beep was not read, it never started)
+    if (enabled) {
+        lock_guard<mutex> lock(beep_mutex);
+        for (auto it = pending_beeps.begin(); it != pending_beeps.end(); ) {
+            if ((it->cancelled && !it->started) || (int64_t)(it->end_sample + ramp) <= out_end) {
+                if (it->segment >= 0) free_segments.push_back(it->segment); // Capacity reserved by PrepareBeep
+                it = pending_beeps.erase(it);
             } else {
-                size_t diff = (size_t)(current_written - target_abs);
-                size_t idx = (ch.head + current_buf_size - (diff % current_buf_size)) % current_buf_size;
-                data_out[i] = ch.buffer[idx];
+                ++it;
             }
         }
     }
     
+    RecordCallback(chrono::steady_clock::now() - callback_start, frames, planes, current_sr);
     return audio;
 }
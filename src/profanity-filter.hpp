@@ -3,15 +3,26 @@
 #include <obs.h>
 #include <string>
 #include <vector>
-#include <deque>
 #include <mutex>
 #include <atomic>
-#include <thread>
+#include <chrono>
 #include <set>
 #include <map>
+#include <future>
+#include <deque>
 #include "sherpa-onnx/c-api/c-api.h"
 #include "asr-model.hpp"
-#include "cpp-pinyin/Pinyin.h"
+#include "spsc-ring.hpp"
+#include "resampler.hpp"
+#include "pinyin-matcher.hpp"
+#include "voice-gate.hpp"
+#include "cascade-verifier.hpp"
+#include "audio-history.hpp"
+#include "delay-line.hpp"
+#include "censor-effects.hpp"
+#include <functional>
+
+class WordMatcher;
 
 class ProfanityFilter {
 public:
@@ -20,51 +31,155 @@ public:
     // Local Properties
     bool enabled = true; 
     
-    // Global Cache
+    // Global Cache (loaded_* is the last requested engine, it may still be loading in the background)
     std::string target_model_path;
     std::string loaded_model_path;
-    double cached_delay = 1.5;
+    EngineMode target_engine_mode = EngineMode::Transducer;
+    EngineMode loaded_engine_mode = EngineMode::Transducer;
+    EngineOptions target_options;
+    EngineOptions loaded_options;
+    uint64_t stream_words_generation = 0; // Word list the stream's keywords / hotwords were built from
+    float stream_hotword_score = 0.0f;
+    std::atomic<double> cached_delay{1.5}; // Written by the audio thread, read by the pool for deadlines
     
     // History
     std::string current_partial_text; 
     std::string loading_target_path;
     std::mutex history_mutex;
 
-    // State
-    std::shared_ptr<ASRModel> asr_model; 
+    // State (asr_model and cascade_model belong to the servicing worker, the UI reads what PublishModelState copied)
+    ModelHandle asr_model;
+    struct ModelSizes {
+        std::atomic<uint64_t> resident_bytes{0};
+        std::atomic<uint64_t> disk_bytes{0};
+    };
+    std::atomic<bool> model_active{false};  // asr_model is loaded and valid
+    ModelSizes model_sizes;
+    ModelSizes cascade_sizes;
+    void PublishModelState(); // Worker side, after asr_model or cascade_model changes
     const SherpaOnnxOnlineStream *stream = nullptr;
     
-    // Audio Buffer
-    struct ChannelBuffer {
-        std::vector<float> buffer;
-        std::vector<float> clean_buffer; // Stores original audio for effect lookback
-        size_t head = 0; 
-        uint64_t total_written = 0;
+    // Model switch: the requested model loads on the ModelManager loader while asr_model keeps decoding,
+    // then replaces it at a segment boundary with the unplayed tail replayed from model_history
+    std::shared_future<ModelLoad> pending_load;
+    bool pending_ready_seen = false;
+    uint64_t pending_ready_16k = 0;     // total_samples_popped_16k when the load was first seen complete
+    bool at_segment_boundary = true;    // Stream just hit an endpoint or is gated by the VAD
+    uint64_t replay_end_16k = 0;        // Matches before this were possibly censored already by the previous model
+    AudioHistory model_history{16000 * 10}; // Model input (after AGC), for the swap replay and the cascade
+    
+    // Audio Buffer: pristine delay line (audio thread), censoring is applied on the way out.
+    // Sized to the configured delay by ReserveDelayLine, off the audio thread; the audio thread carries
+    // the history over to delay_line_next in bounded slices (kHandoverSamples per callback), then swaps.
+    // The retired storage is freed by the ASR worker (ReleaseRetiredDelayLine).
+    DelayLine delay_line;
+    std::mutex delay_mutex;                      // Guards delay_line_next, the audio thread only try-locks it
+    DelayLine delay_line_next;                   // Pending storage, or the retired one after the swap
+    std::atomic<bool> delay_line_ready{false};   // delay_line_next is pending
+    std::atomic<bool> delay_line_retired{false}; // delay_line_next holds the storage the last swap retired
+    std::atomic<bool> delay_handover{false};     // The audio thread is taking over delay_line_next
+    std::atomic<size_t> delay_capacity{0};       // Of delay_line, published by the audio thread
+    std::atomic<size_t> delay_channels{0};
+    std::atomic<double> delay_memory_mb{0.0};    // delay_line + delay_line_next
+    static std::atomic<double> total_delay_memory_mb;
+    void ReserveDelayLine(double delay_seconds);
+    void ReleaseRetiredDelayLine(); // ASR side
+    void UpdateDelayMemory(); // delay_mutex held
+    
+    // Cost of ProcessAudio (audio thread only), logged periodically
+    struct CallbackStats {
+        uint64_t ns = 0;
+        uint64_t max_ns = 0;
+        uint64_t frames = 0;
+        uint64_t blocks = 0;
     };
+    CallbackStats callback_stats;
+    void RecordCallback(std::chrono::steady_clock::duration elapsed, size_t frames, size_t planes, uint32_t sr);
     
-    std::vector<ChannelBuffer> channels;
     std::atomic<uint32_t> sample_rate{48000};
     std::atomic<double> sample_rate_ratio{3.0}; // sample_rate / 16000.0
     std::atomic<uint64_t> total_samples_written{0}; 
-    size_t channels_count = 0;
     
-    // Resampler state
-    float resample_acc = 0.0f;
+    // Resampler state (input rate -> 16kHz, audio thread only). The filter bank for a new input rate is
+    // built off the audio thread (ReserveDelayLine) and swapped in by the next callback.
+    PolyphaseResampler resampler;
+    std::mutex resampler_mutex;                   // Guards resampler_next, the audio thread only try-locks it
+    PolyphaseResampler resampler_next;            // Pending bank, or the retired one after the swap
+    std::atomic<bool> resampler_ready{false};     // resampler_next is pending
+    std::atomic<uint32_t> resampler_rate{0};      // Input rate of the newest bank built
     
-    // ASR Thread
-    std::thread asr_thread;
+    // ASR runs on the shared ASRWorkerPool, at most one worker services this filter at a time
     std::atomic<bool> running{false};
-    std::mutex queue_mutex;
-    std::deque<float> asr_queue; 
+    
+    // Audio -> ASR hand-off (audio thread writes, ASR worker reads)
+    // ~65s of 16kHz audio, preallocated so the audio callback never allocates
+    SpscRing<float> asr_ring{16000 * 60};
+    std::vector<float> asr_scratch; // Downsampled block staging (audio thread only)
+    
+    // The audio thread wakes the pool once asr_wake_samples are queued (it never takes a mutex)
+    std::atomic<size_t> asr_wake_samples{1600};
+    
+    // ASR-side state (only touched by the worker currently servicing this filter)
+    uint64_t total_samples_popped_16k = 0;
+    uint64_t start_offset_input = 0;    // Time sync: input sample that 16k sample 0 maps to
+    uint64_t last_feed_offset = 0;
+    uint64_t seen_overflow_events = 0;
+    float current_agc_gain = 1.0f;
+    std::vector<float> asr_chunk;
+    double chunk_ratio = 3.0;           // Rate of the chunk fed by AsrFeed, used by AsrHandleResult
+    uint32_t chunk_sr = 48000;
+    
+    // Voice activity gating (optional), skipped audio is never fed to the recognizer
+    std::unique_ptr<VoiceGate> voice_gate;
+    bool voice_gate_failed = false;     // Do not retry loading every chunk
+    std::atomic<uint64_t> vad_samples_total{0};
+    std::atomic<uint64_t> vad_samples_skipped{0};
+    double VadSkipRate() const;
     
     // Beep Map
     struct BeepRange {
         uint64_t start_sample; 
         uint64_t end_sample;
         uint64_t original_start;
+        bool scheduled = false; // Deadline checked (first time the audio thread saw it)
+        int segment = -1;            // Pre-rendered replacement audio in segment_pool, -1: rendered at playout
+        uint64_t segment_start = 0;  // Input position of the segment's first sample (start_sample minus the fade)
+        uint64_t signature = 0;      // CensorRenderer::Signature the segment was rendered with
+        uint64_t id = 0;             // Nonzero if the beep can still be withdrawn (CancelBeep)
+        bool started = false;        // Part of it was played out, so it is kept to the end
+        bool cancelled = false;      // Withdrawn before playout, dropped by the audio thread
     };
     std::mutex beep_mutex;
-    std::vector<BeepRange> pending_beeps;
+    std::vector<BeepRange> pending_beeps;        // Kept until played out, so late matches still apply
+    uint64_t next_beep_id = 0;                   // Guarded by beep_mutex
+    
+    // Replacement audio is rendered on the ASR side as soon as a match is known, into pooled segments
+    // (beep_mutex guards the pool lists; a segment's samples belong to the beep holding its index)
+    std::deque<std::vector<float>> segment_pool;
+    std::vector<int> free_segments;              // Capacity >= segment_pool.size(), so the audio thread never allocates
+    CensorRenderer segment_renderer;             // ASR side, configured from the snapshot taken in AsrFeed
+    BeepRange PrepareBeep(uint64_t start_abs, uint64_t end_abs); // ASR side, beep_mutex not held
+    
+    // Censoring of the current output block (audio thread)
+    struct CensorSpan {
+        uint64_t start;
+        uint64_t end;
+        const float *wet;        // Pre-rendered segment, nullptr: rendered at playout
+        uint64_t wet_start;
+        size_t wet_size;
+    };
+    struct CensorRegion {
+        uint64_t start;          // Merged spans
+        uint64_t end;
+        size_t first_span;       // [first_span, last_span) in censor_spans
+        size_t last_span;
+        bool prerendered;        // Every span has a usable segment
+    };
+    std::vector<CensorSpan> censor_spans;
+    std::vector<CensorRegion> censor_regions;
+    CensorRenderer censor_renderer;
+    std::vector<float> effect_scratch;           // Pristine input of a region plus the effect lookback
+    std::vector<float> wet_scratch;              // Stitched replacement audio of a region
     
     std::string initialization_error = "";
     std::atomic<bool> is_loading{false};
@@ -72,23 +187,89 @@ public:
     
     obs_data_t *settings = nullptr;
     uint64_t last_reset_sample_16k = 0;
-    std::set<size_t> processed_matches; 
-    std::atomic<size_t> dropped_beeps_count{0};
     
-    // Pinyin Support
-    std::shared_ptr<Pinyin::Pinyin> pinyin_converter;
-    std::vector<std::vector<std::string>> cached_pinyin_patterns;
-    std::string cached_dirty_words_str_for_pinyin;
-    // Cache for single hanzi pinyin to avoid re-conversion
-    std::map<std::string, std::vector<std::string>> pinyin_cache;
+    // Incremental matching state, reset together with the stream segment
+    static constexpr size_t kUnstableTailTokens = 8; // Recent tokens the decoder may still revise
+    struct MatchCursor {
+        size_t stable_tokens = 0;        // Tokens before this index were matched and are treated as final
+        uint64_t words_generation = 0;   // Word list the stable prefix was matched against
+        uint64_t pinyin_generation = 0;  // Pinyin matcher build it was matched against (0 = pinyin off)
+        std::set<size_t> reported;       // Start tokens already reported (pruned to the scan window)
+        std::set<size_t> escalated;      // Start tokens already sent to the cascade (pruned the same way)
+    };
+    MatchCursor match_cursor;
+    void ResetMatchCursor();
+    
+    // Deadline accounting: a beep misses its deadline when its start was already played out
+    // by the time the audio thread got it (censored late, or dropped entirely)
+    std::atomic<uint64_t> beeps_scheduled{0};
+    std::atomic<uint64_t> deadline_misses{0};
+    double DeadlineMissRate() const;
+    
+    // Pinyin Support (patterns live in the shared SharedPinyinMatcher, syllables are interned IDs)
+    std::vector<int32_t> text_syllables;    // Reused per chunk
+    std::vector<size_t> syllable_to_token;  // Reused per chunk
+    std::vector<PinyinMatcher::Match> pinyin_matches; // Reused per chunk
+    std::vector<PinyinMatcher::Match> near_matches;   // Reused per chunk (cascade)
+    std::vector<int32_t> near_initials;               // Reused per chunk (cascade)
+    
+    // Two-tier cascade (optional): the loaded model runs continuously, suspicious windows are re-decoded
+    // by cascade_model from the verifier's audio history, within the remaining delay budget
+    struct Escalation {
+        uint64_t span_start_16k;     // Suspicious span (absolute 16k samples)
+        uint64_t span_end_16k;
+        uint64_t beep_id;            // First-tier hit (KWS): already censored, withdrawn on a negative verdict. 0: near miss
+        std::chrono::steady_clock::time_point created;
+        std::string text;            // What the first tier heard, for the log
+    };
+    std::string target_cascade_path;
+    std::string loaded_cascade_path;
+    ModelHandle cascade_model;
+    std::shared_future<ModelLoad> pending_cascade_load;
+    std::unique_ptr<CascadeVerifier> cascade_verifier;
+    std::vector<Escalation> escalations;  // Oldest first
+    double cascade_decode_ms = 250.0;     // Running estimate of one window decode, used as the budget check
+    std::atomic<uint64_t> cascade_audio_16k{0};      // Audio seen while the cascade was on
+    std::atomic<uint64_t> cascade_escalated_16k{0};  // Audio re-decoded by the large model
+    std::atomic<uint64_t> cascade_windows{0};
+    std::atomic<uint64_t> cascade_latency_ms{0};     // Sum over windows: suspicion -> verdict
+    std::atomic<uint64_t> cascade_timeouts{0};       // Windows dropped because the deadline was too close
+    // Queues a window unless it cannot be complete and decoded before the span plays out
+    void Escalate(uint64_t span_start_16k, uint64_t span_end_16k, uint64_t beep_id, const std::string &text);
+    double CascadeSlackMs(uint64_t span_start_16k) const; // Time left before the span starts playing out
     
     ProfanityFilter(obs_source_t *ctx);
     ~ProfanityFilter();
 
-    void LoadModel(const std::string& path);
+    // Starts loading the model in the background (an empty path unloads at once)
+    void RequestModel(const std::string& path, EngineMode mode, const EngineOptions& options, const std::vector<std::string>& words);
+    // Swaps in the requested model once loaded, at a segment boundary (or forced after kSwapMaxWait of speech)
+    void AsrPollModelLoad(const std::vector<std::string>& words, uint64_t words_generation, float hotword_score);
+    // Queues a censor range from the live stream, false if it repeats one the previous model already queued.
+    // With id set, the beep can be withdrawn until it starts playing (CancelBeep).
+    bool QueueBeep(uint64_t start_abs, uint64_t end_abs, uint64_t start_16k, uint64_t *id = nullptr);
+    bool CancelBeep(uint64_t id); // False if it already started playing (or played out)
+    // Widens a queued beep to also cover [start_abs, end_abs). False if the ranges do not overlap or
+    // the beep started playing (or played out), the range then needs a beep of its own.
+    bool ExtendBeep(uint64_t id, uint64_t start_abs, uint64_t end_abs);
     void Start();
     void Stop();
-    void ASRLoop();
+    
+    // ASR steps, called by ASRWorkerPool
+    void AsrInitTimeSync();
+    bool AsrDue(std::chrono::steady_clock::duration since_last_service) const;
+    double AsrSlackMs() const; // Time left before the oldest queued audio plays out (EDF key)
+    bool AsrFeed();          // Reads queued audio into the stream, true if it needs decoding
+    void AsrHandleResult();  // After the pool decoded the stream: matching, beeps, endpoint handling
+    void AsrHandleKeywordResult();
+    void AsrRunEscalations(); // Cascade windows whose audio is complete, called after every service
+    // Stream time (seconds since the 16k sample base_16k) -> absolute input samples, with model offset and safety margin
+    void StreamTimeToInput(uint64_t base_16k, float start_time, float end_time, int model_offset_ms, uint64_t &start_abs, uint64_t &end_abs) const;
+    // Dirty words in tokens [window_start, count) of a result: on_match(start_token, end_token, log_text, is_pinyin).
+    // Leaves the window's syllables in text_syllables / syllable_to_token (empty without pinyin).
+    void MatchTokens(const SherpaOnnxOnlineRecognizerResult *result, size_t window_start,
+                     const WordMatcher *matcher, const PinyinMatcher *pinyin_matcher, const TokenPinyinTable *pinyin_table,
+                     const std::function<void(size_t, size_t, std::string, bool)> &on_match);
     
     struct obs_audio_data *ProcessAudio(struct obs_audio_data *audio);
 
@@ -96,4 +277,12 @@ public:
     static std::set<ProfanityFilter*> instances;
     static std::mutex instances_mutex;
     static std::pair<bool, std::string> GetGlobalModelStatus();
+    // Resizes every filter's delay line to the configured delay (config applied)
+    static void ReserveDelayLines();
+    
+    // Warm start (module load): loads the configured models in the background so the first filter finds them
+    // in the ModelManager cache, already warmed up
+    static void PreloadModels();
+    static std::shared_future<ModelLoad> preload;   // Guarded by instances_mutex, dropped once a filter takes over
+    static std::string preload_path;
 };
@@ -0,0 +1,160 @@
+#include "resampler.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RESAMPLER_SSE 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RESAMPLER_NEON 1
+#endif
+
+using namespace std;
+
+static constexpr double kPi = 3.14159265358979323846;
+
+// Zeroth-order modified Bessel function (Kaiser window)
+static double BesselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    double q = x * x / 4.0;
+    for (int k = 1; k < 64; k++) {
+        term *= q / ((double)k * (double)k);
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+// n is always a multiple of 8 (kTapsPerPhase)
+static inline float DotProduct(const float *a, const float *b, size_t n) {
+#if defined(RESAMPLER_SSE)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (size_t i = 0; i < n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    acc0 = _mm_add_ps(acc0, _mm_movehl_ps(acc0, acc0));
+    acc0 = _mm_add_ss(acc0, _mm_shuffle_ps(acc0, acc0, 1));
+    return _mm_cvtss_f32(acc0);
+#elif defined(RESAMPLER_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (size_t i = 0; i < n; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    acc0 = vaddq_f32(acc0, acc1);
+    float32x2_t s = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+#else
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    for (size_t i = 0; i < n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    return (s0 + s1) + (s2 + s3);
+#endif
+}
+
+void PolyphaseResampler::Configure(uint32_t in_rate, uint32_t out_rate) {
+    if (in_rate == 0 || out_rate == 0) return;
+
+    uint32_t g = gcd(in_rate, out_rate);
+    in_rate_ = in_rate;
+    out_rate_ = out_rate;
+    up_ = out_rate / g;
+    down_ = in_rate / g;
+
+    const size_t taps = kTapsPerPhase;
+    const size_t proto_len = taps * up_;
+
+    // Prototype runs at in_rate * up_. Kaiser design: a window of proto_len samples and beta for
+    // kStopbandDb gives a transition of (A - 7.95) / (14.36 * (proto_len - 1)) of the prototype rate
+    // (~1.9 kHz at 48k or 44.1k input). The band edge sits half of it below the lower Nyquist, so the
+    // stopband starts at the Nyquist and nothing above it aliases into the speech band.
+    double nyquist = 0.5 * min(in_rate, out_rate);
+    double proto_rate = (double)in_rate * up_;
+    double transition = (kStopbandDb - 7.95) / (14.36 * (double)(proto_len - 1)) * proto_rate;
+    double cutoff = (nyquist - 0.5 * transition) / proto_rate; // cycles per prototype sample
+    double beta = 0.1102 * (kStopbandDb - 8.7);
+    double i0_beta = BesselI0(beta);
+    double center = (double)(proto_len - 1) / 2.0;
+
+    vector<double> proto(proto_len);
+    for (size_t i = 0; i < proto_len; i++) {
+        double x = (double)i - center;
+        double sinc = (x == 0.0) ? 2.0 * cutoff : sin(2.0 * kPi * cutoff * x) / (kPi * x);
+        double r = x / center;
+        double window = BesselI0(beta * sqrt(max(0.0, 1.0 - r * r))) / i0_beta;
+        proto[i] = sinc * window;
+    }
+
+    // Split into phases. For output at input position base + p/up_:
+    //   y = sum_j proto[p + j*up_] * x[base - j]
+    // Stored reversed so the inner loop is a forward dot product over work_[base .. base + taps - 1].
+    coeffs_.assign(up_ * taps, 0.0f);
+    for (uint32_t p = 0; p < up_; p++) {
+        double sum = 0.0;
+        for (size_t j = 0; j < taps; j++) sum += proto[p + j * up_];
+        double norm = (sum != 0.0) ? 1.0 / sum : 0.0; // Unity DC gain per phase
+        float *dst = &coeffs_[p * taps];
+        for (size_t j = 0; j < taps; j++) {
+            dst[taps - 1 - j] = (float)(proto[p + j * up_] * norm);
+        }
+    }
+
+    Reset();
+}
+
+void PolyphaseResampler::Swap(PolyphaseResampler &other) {
+    swap(in_rate_, other.in_rate_);
+    swap(out_rate_, other.out_rate_);
+    swap(up_, other.up_);
+    swap(down_, other.down_);
+    coeffs_.swap(other.coeffs_);
+    work_.swap(other.work_);
+    swap(time_, other.time_);
+}
+
+void PolyphaseResampler::Reset() {
+    work_.assign(max(work_.size(), kTapsPerPhase - 1 + 4096), 0.0f);
+    time_ = 0;
+}
+
+size_t PolyphaseResampler::MaxOutput(size_t n) const {
+    if (!up_) return 0;
+    return (size_t)(((uint64_t)n * up_) / down_) + 1;
+}
+
+size_t PolyphaseResampler::Process(const float *in, size_t n, float *out) {
+    if (!up_ || n == 0) return 0;
+
+    const size_t taps = kTapsPerPhase;
+    const size_t hist = taps - 1;
+    if (work_.size() < hist + n) work_.resize(hist + n, 0.0f);
+
+    memcpy(&work_[hist], in, n * sizeof(float));
+
+    size_t produced = 0;
+    const uint64_t end = (uint64_t)n * up_;
+    while (time_ < end) {
+        size_t base = (size_t)(time_ / up_);
+        size_t phase = (size_t)(time_ % up_);
+        out[produced++] = DotProduct(&coeffs_[phase * taps], &work_[base], taps);
+        time_ += down_;
+    }
+    time_ -= end;
+
+    // Keep the last (taps - 1) inputs as history for the next block
+    memmove(&work_[0], &work_[n], hist * sizeof(float));
+    return produced;
+}
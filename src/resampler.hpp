@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Anti-aliased polyphase FIR resampler with an exact rational ratio (e.g. 48k->16k = 1:3, 44.1k->16k = 160:441).
+// Kaiser-windowed sinc prototype, one coefficient set per phase, whole-block processing.
+// The stopband starts at the output Nyquist, so nothing folds back into the output band above -kStopbandDb.
+// Each instance owns its filter history and phase, so several sources can resample independently.
+class PolyphaseResampler {
+public:
+    static constexpr size_t kTapsPerPhase = 128;
+    static constexpr double kStopbandDb = 80.0; // Attenuation from the lower Nyquist up
+
+    // Rebuilds the filter bank. Allocates, call it off the audio thread and hand the result over with Swap.
+    void Configure(uint32_t in_rate, uint32_t out_rate);
+
+    // Exchanges filter banks, history and phase. Never allocates.
+    void Swap(PolyphaseResampler &other);
+
+    // Clears history and phase without touching the filter bank
+    void Reset();
+
+    // Upper bound on output samples produced for n input samples
+    size_t MaxOutput(size_t n) const;
+
+    // Resamples one block. out must hold at least MaxOutput(n) samples. Returns samples written.
+    // Does not allocate unless n exceeds the largest block seen so far.
+    size_t Process(const float *in, size_t n, float *out);
+
+    bool IsConfigured() const { return up_ != 0; }
+    uint32_t InputRate() const { return in_rate_; }
+    uint32_t Up() const { return up_; }
+    uint32_t Down() const { return down_; }
+
+private:
+    uint32_t in_rate_ = 0;
+    uint32_t out_rate_ = 0;
+    uint32_t up_ = 0;   // L
+    uint32_t down_ = 0; // M
+
+    std::vector<float> coeffs_; // up_ phases x kTapsPerPhase, each phase laid out for a forward dot product
+    std::vector<float> work_;   // (kTapsPerPhase - 1) history samples followed by the current block
+    uint64_t time_ = 0;         // Next output position relative to the block start, in 1/up_ input samples
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// Lock-free single-producer / single-consumer ring buffer.
+// Storage is allocated once in the constructor; Write() and Read() never block or allocate.
+// Positions are free-running 64-bit counters, so indexing is a mask and full/empty never alias.
+template <typename T>
+class SpscRing {
+public:
+    // Capacity is rounded up to the next power of two
+    explicit SpscRing(size_t min_capacity) {
+        size_t cap = 1;
+        while (cap < min_capacity) cap <<= 1;
+        buffer_.resize(cap);
+        mask_ = cap - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Producer: writes the whole block or nothing.
+    // If the consumer has fallen behind, the block is dropped and counted as overflow.
+    bool Write(const T *data, size_t n) {
+        if (n == 0) return true;
+        uint64_t w = write_pos_.load(std::memory_order_relaxed);
+        uint64_t r = read_pos_.load(std::memory_order_acquire);
+        if (buffer_.size() - (size_t)(w - r) < n) {
+            overflow_samples_.fetch_add(n, std::memory_order_relaxed);
+            overflow_events_.fetch_add(1, std::memory_order_release);
+            return false;
+        }
+
+        size_t idx = (size_t)(w & mask_);
+        size_t first = std::min(n, buffer_.size() - idx);
+        memcpy(&buffer_[idx], data, first * sizeof(T));
+        if (first < n) memcpy(&buffer_[0], data + first, (n - first) * sizeof(T));
+
+        write_pos_.store(w + n, std::memory_order_release);
+        return true;
+    }
+
+    // Producer: counts a block as dropped without writing it, the consumer sees it like an overflow
+    void Drop(size_t n) {
+        overflow_samples_.fetch_add(n, std::memory_order_relaxed);
+        overflow_events_.fetch_add(1, std::memory_order_release);
+    }
+
+    // Consumer: copies up to max_n samples out, returns the number read
+    size_t Read(T *out, size_t max_n) {
+        uint64_t r = read_pos_.load(std::memory_order_relaxed);
+        uint64_t w = write_pos_.load(std::memory_order_acquire);
+        size_t n = std::min(max_n, (size_t)(w - r));
+        if (n == 0) return 0;
+
+        size_t idx = (size_t)(r & mask_);
+        size_t first = std::min(n, buffer_.size() - idx);
+        memcpy(out, &buffer_[idx], first * sizeof(T));
+        if (first < n) memcpy(out + first, &buffer_[0], (n - first) * sizeof(T));
+
+        read_pos_.store(r + n, std::memory_order_release);
+        return n;
+    }
+
+    // Consumer: discards everything currently queued
+    void Clear() {
+        read_pos_.store(write_pos_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    // Approximate from either side, exact from the consumer
+    size_t Size() const {
+        uint64_t w = write_pos_.load(std::memory_order_acquire);
+        uint64_t r = read_pos_.load(std::memory_order_acquire);
+        return (size_t)(w - r);
+    }
+
+    size_t Capacity() const { return buffer_.size(); }
+
+    // Number of Write() calls that were dropped because the ring was full
+    uint64_t OverflowEvents() const { return overflow_events_.load(std::memory_order_acquire); }
+    uint64_t OverflowSamples() const { return overflow_samples_.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<T> buffer_;
+    size_t mask_ = 0;
+
+    // Keep producer and consumer indices on separate cache lines
+    alignas(64) std::atomic<uint64_t> write_pos_{0};
+    alignas(64) std::atomic<uint64_t> read_pos_{0};
+    alignas(64) std::atomic<uint64_t> overflow_events_{0};
+    std::atomic<uint64_t> overflow_samples_{0};
+};
@@ -1,5 +1,8 @@
 #include "utils.hpp"
 
+#include <windows.h>
+#include <psapi.h>
+
 std::string NormalizePinyin(const std::string& p) {
     std::string s = p;
     // Map zh->z, ch->c, sh->s
@@ -14,3 +17,9 @@ std::string NormalizePinyin(const std::string& p) {
     }
     return s;
 }
+
+size_t GetProcessPrivateBytes() {
+    PROCESS_MEMORY_COUNTERS_EX pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc))) return 0;
+    return pmc.PrivateUsage;
+}
@@ -3,3 +3,6 @@
 #include <string>
 
 std::string NormalizePinyin(const std::string& p);
+
+// Private memory of this process in bytes (0 if unavailable)
+size_t GetProcessPrivateBytes();
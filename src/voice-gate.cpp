@@ -0,0 +1,96 @@
+#include "voice-gate.hpp"
+#include "logging-macros.hpp"
+
+#include <obs-module.h>
+
+#include <filesystem>
+#include <cstring>
+
+using namespace std;
+
+static constexpr size_t kPreRollSamples = 16000 / 2;   // 500 ms, covers Silero's min speech duration plus a word onset
+static constexpr size_t kHangoverSamples = 16000 * 3 / 10; // 300 ms after the VAD drops, lets the decoder finish the last word
+
+static string FindVadModel() {
+    // 1. Plugin data directory (bundled)
+    char *p = obs_module_file("silero_vad.onnx");
+    if (p) {
+        string path = p;
+        bfree(p);
+        if (filesystem::exists(path)) return path;
+    }
+
+    // 2. Models directory next to the downloaded ASR models
+    p = obs_module_get_config_path(obs_current_module(), "models/silero_vad.onnx");
+    if (p) {
+        string path = p;
+        bfree(p);
+        if (filesystem::exists(path)) return path;
+    }
+    return "";
+}
+
+unique_ptr<VoiceGate> VoiceGate::Create() {
+    string model = FindVadModel();
+    if (model.empty()) {
+        BLOG(LOG_WARNING, "VAD enabled but silero_vad.onnx was not found (data or models folder), audio is not gated");
+        return nullptr;
+    }
+
+    SherpaOnnxVadModelConfig config;
+    memset(&config, 0, sizeof(config));
+    config.silero_vad.model = model.c_str();
+    config.silero_vad.threshold = 0.5f;
+    config.silero_vad.min_silence_duration = 0.25f;
+    config.silero_vad.min_speech_duration = 0.1f;
+    config.silero_vad.window_size = 512;
+    config.silero_vad.max_speech_duration = 30.0f;
+    config.sample_rate = 16000;
+    config.num_threads = 1;
+    config.provider = "cpu";
+
+    const SherpaOnnxVoiceActivityDetector *detector = SherpaOnnxCreateVoiceActivityDetector(&config, 30.0f);
+    if (!detector) {
+        BLOG(LOG_ERROR, "Failed to create VAD from %s", model.c_str());
+        return nullptr;
+    }
+    BLOG(LOG_INFO, "VAD initialized from: %s", model.c_str());
+    return unique_ptr<VoiceGate>(new VoiceGate(detector));
+}
+
+VoiceGate::VoiceGate(const SherpaOnnxVoiceActivityDetector *detector) : detector_(detector) {
+    preroll_.reserve(kPreRollSamples + 16000);
+}
+
+VoiceGate::~VoiceGate() {
+    SherpaOnnxDestroyVoiceActivityDetector(detector_);
+}
+
+VoiceGate::Decision VoiceGate::Process(const float *samples, size_t n) {
+    SherpaOnnxVoiceActivityDetectorAcceptWaveform(detector_, samples, (int32_t)n);
+    // Only the live speech flag is used, drop the buffered segments
+    SherpaOnnxVoiceActivityDetectorClear(detector_);
+
+    bool speech = SherpaOnnxVoiceActivityDetectorDetected(detector_) != 0;
+    if (speech) {
+        hangover_remaining_ = kHangoverSamples;
+    } else {
+        hangover_remaining_ = (hangover_remaining_ > n) ? hangover_remaining_ - n : 0;
+    }
+    bool active = speech || hangover_remaining_ > 0;
+
+    if (active) {
+        bool onset = !active_;
+        active_ = true;
+        // On Onset the caller reads the pre-roll first, it is dropped on the following chunk
+        if (!onset) preroll_.clear();
+        return onset ? Decision::Onset : Decision::Continue;
+    }
+
+    active_ = false;
+    preroll_.insert(preroll_.end(), samples, samples + n);
+    if (preroll_.size() > kPreRollSamples) {
+        preroll_.erase(preroll_.begin(), preroll_.end() - kPreRollSamples);
+    }
+    return Decision::Skip;
+}
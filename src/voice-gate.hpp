@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include "sherpa-onnx/c-api/c-api.h"
+
+// Silero VAD in front of the recognizer: silence is neither fed nor decoded.
+// While gated, the most recent audio is kept as pre-roll so the onset of speech (which the VAD only
+// confirms after min_speech_duration) still reaches the recognizer.
+class VoiceGate {
+public:
+    enum class Decision {
+        Skip,     // Non-speech, do not feed
+        Continue, // Speech (or hangover) continuing, feed the chunk
+        Onset     // Speech just started: feed PreRoll() and then the chunk into a fresh segment
+    };
+
+    // nullptr if silero_vad.onnx cannot be found or loaded
+    static std::unique_ptr<VoiceGate> Create();
+    ~VoiceGate();
+
+    // 16 kHz samples, one ASR chunk at a time
+    Decision Process(const float *samples, size_t n);
+
+    // Audio immediately preceding the chunk that returned Onset
+    const std::vector<float> &PreRoll() const { return preroll_; }
+
+private:
+    explicit VoiceGate(const SherpaOnnxVoiceActivityDetector *detector);
+
+    const SherpaOnnxVoiceActivityDetector *detector_;
+    std::vector<float> preroll_;
+    size_t hangover_remaining_ = 0;
+    bool active_ = false;
+};
@@ -0,0 +1,63 @@
+#include "word-matcher.hpp"
+
+using namespace std;
+
+// std::regex icase only folds ASCII for narrow strings, mirror that here
+static inline uint8_t FoldCase(uint8_t c) {
+    return (c >= 'A' && c <= 'Z') ? (uint8_t)(c + ('a' - 'A')) : c;
+}
+
+bool WordMatcher::IsRegexWord(const string &word) {
+    return word.find_first_of("\\^$.|?*+()[]{}") != string::npos;
+}
+
+void WordMatcher::Build(const vector<string> &words) {
+    literals_.Clear();
+    regex_patterns_.clear();
+    max_literal_chars_ = 0;
+
+    vector<uint8_t> folded;
+    for (const auto &w : words) {
+        if (w.empty()) continue;
+        if (IsRegexWord(w)) {
+            try {
+                regex_patterns_.emplace_back(w, regex::icase);
+            } catch(...) {}
+            continue;
+        }
+        folded.assign(w.begin(), w.end());
+        size_t chars = 0;
+        for (auto &c : folded) {
+            if ((c & 0xC0) != 0x80) chars++; // Count lead bytes only
+            c = FoldCase(c);
+        }
+        literals_.Add(folded.data(), folded.size());
+        max_literal_chars_ = max(max_literal_chars_, chars);
+    }
+    literals_.Compile();
+}
+
+void WordMatcher::FindAll(const string &text, vector<Match> &out) const {
+    if (!literals_.Empty()) {
+        // UTF-8 is self-synchronizing, so byte-level matches of valid UTF-8 words always land on character boundaries
+        int32_t state = 0;
+        for (size_t i = 0; i < text.size(); i++) {
+            state = literals_.Step(state, FoldCase((uint8_t)text[i]));
+            literals_.ForEachOutput(state, [&](int32_t, size_t len) {
+                out.push_back({i + 1 - len, len});
+            });
+        }
+    }
+
+    for (const auto &pattern : regex_patterns_) {
+        sregex_iterator begin(text.begin(), text.end(), pattern);
+        sregex_iterator end;
+        for (auto it = begin; it != end; ++it) {
+            if (it->length() > 0) out.push_back({(size_t)it->position(), (size_t)it->length()});
+        }
+    }
+}
+
+size_t WordMatcher::MaxMatchChars() const {
+    return regex_patterns_.empty() ? max_literal_chars_ : SIZE_MAX;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <regex>
+#include <cstdint>
+#include "aho-corasick.hpp"
+
+// Dirty word matcher.
+// Literal words (the common case) are compiled into one case-insensitive UTF-8 Aho-Corasick automaton
+// and found in a single pass. Entries containing regex syntax keep going through std::regex.
+class WordMatcher {
+public:
+    struct Match {
+        size_t start;   // Byte offset in the scanned text
+        size_t length;  // Byte length
+    };
+
+    void Build(const std::vector<std::string> &words);
+
+    // Appends all matches in text to out (literal matches first, then regex matches)
+    void FindAll(const std::string &text, std::vector<Match> &out) const;
+
+    size_t LiteralCount() const { return literals_.PatternCount(); }
+    size_t RegexCount() const { return regex_patterns_.size(); }
+
+    // Longest literal in UTF-8 code points (an upper bound on the tokens a match can span).
+    // Regex entries are unbounded and make this SIZE_MAX.
+    size_t MaxMatchChars() const;
+
+    static bool IsRegexWord(const std::string &word);
+
+private:
+    AhoCorasick<uint8_t> literals_;
+    std::vector<std::regex> regex_patterns_;
+    size_t max_literal_chars_ = 0;
+};